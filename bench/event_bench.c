@@ -0,0 +1,145 @@
+/* Per token cost of the one event at a time parser loop against the
+ * batched get_parser_events API.
+ *
+ * Both loops feed the same consumer, a per type count of tokens and
+ * bytes like a stats pass would keep, over a source file held in memory.
+ *
+ * build: cmake --build <build dir> --target event_bench
+ * usage: ./event_bench <source file> [runs]
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "s2html_event.h"
+#include "s2html_lang.h"
+
+#define BENCH_BATCH_EVENTS	1024
+
+//structure to hold what the consumer computes
+typedef struct
+{
+	long tokens[PEVENT_EOF + 1];
+	long bytes[PEVENT_EOF + 1];
+	long total;
+}bench_stats_t;
+
+static double now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* the loop of convert_stream: one get_parser_event call per token */
+static void bench_single(const char *src_file, char *buf, size_t len, bench_stats_t *stats)
+{
+	pevent_t *event;
+	FILE *fp = fmemopen(buf, len, "r");
+
+	lang_select(src_file);
+	reset_parser();
+	do
+	{
+		event = get_parser_event(fp);
+		stats->tokens[event->type]++;
+		stats->bytes[event->type] += event->length;
+		stats->total++;
+	} while (event->type != PEVENT_EOF);
+	fclose(fp);
+}
+
+/* batched loop: the consumer walks the arrays */
+static void bench_batch(const char *src_file, char *buf, size_t len, pevent_batch_t *batch, bench_stats_t *stats)
+{
+	FILE *fp = fmemopen(buf, len, "r");
+	int idx;
+
+	lang_select(src_file);
+	reset_parser();
+	do
+	{
+		get_parser_events(fp, batch);
+		for(idx = 0; idx < batch->count; idx++)
+		{
+			stats->tokens[batch->types[idx]]++;
+			stats->bytes[batch->types[idx]] += batch->lengths[idx];
+		}
+		stats->total += batch->count;
+	} while (batch->types[batch->count - 1] != PEVENT_EOF);
+	fclose(fp);
+}
+
+int main(int argc, char *argv[])
+{
+	static pevent_e types[BENCH_BATCH_EVENTS];
+	static int properties[BENCH_BATCH_EVENTS];
+	static long offsets[BENCH_BATCH_EVENTS];
+	static int lengths[BENCH_BATCH_EVENTS];
+	static char text[BENCH_BATCH_EVENTS * 16 + PEVENT_DATA_SIZE];
+	pevent_batch_t batch = {types, properties, offsets, lengths, BENCH_BATCH_EVENTS, text, sizeof(text), 0, 0};
+	bench_stats_t single, batched;
+	double t, best_single = 0, best_batch = 0;
+	char *buf;
+	long len;
+	int run, runs;
+	FILE *fp;
+
+	if(argc < 2)
+	{
+		printf("Usage: %s <source file> [runs]\n", argv[0]);
+		return 1;
+	}
+	runs = argc > 2 ? atoi(argv[2]) : 5;
+
+	if((fp = fopen(argv[1], "r")) == NULL)
+	{
+		printf("Error! File %s could not be opened\n", argv[1]);
+		return 2;
+	}
+	fseek(fp, 0, SEEK_END);
+	len = ftell(fp);
+	rewind(fp);
+	buf = malloc(len + 1);
+	if(!buf || fread(buf, 1, len, fp) != (size_t)len)
+	{
+		printf("Error! File %s could not be read\n", argv[1]);
+		return 2;
+	}
+	fclose(fp);
+
+	/* best of runs, the loops take turns so both see the same machine state */
+	for(run = 0; run < runs; run++)
+	{
+		memset(&single, 0, sizeof(single));
+		t = now_ns();
+		bench_single(argv[1], buf, len, &single);
+		t = now_ns() - t;
+		if(run == 0 || t < best_single)
+			best_single = t;
+
+		memset(&batched, 0, sizeof(batched));
+		t = now_ns();
+		bench_batch(argv[1], buf, len, &batch, &batched);
+		t = now_ns() - t;
+		if(run == 0 || t < best_batch)
+			best_batch = t;
+	}
+
+	if(memcmp(&single, &batched, sizeof(single)) != 0)
+	{
+		printf("Error! the loops saw different tokens\n");
+		return 4;
+	}
+
+	printf("%ld tokens, %ld bytes\n", single.total, len);
+	printf("get_parser_event  : %6.1f ns/token\n", best_single / single.total);
+	printf("get_parser_events : %6.1f ns/token (%d events per batch)\n", best_batch / batched.total, BENCH_BATCH_EVENTS);
+	printf("speedup           : %6.2fx\n", best_single / best_batch);
+
+	free(buf);
+	return 0;
+}
+/**** End of file ****/
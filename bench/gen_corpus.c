@@ -0,0 +1,165 @@
+/* Generate a tree of C files to train and time the converter on.
+ *
+ * The files mix what real C sources have: includes, macros, comments of
+ * both kinds, keywords, identifiers, numbers, strings with escapes and
+ * char constants. The same arguments always give the same tree.
+ *
+ * usage: ./gen_corpus <directory> [files] [functions per file]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <sys/stat.h>
+
+#define CORPUS_DIR_FILES	100 /* files per sub directory */
+
+static unsigned long seed = 12345;
+
+static const char *headers[] = {"stdio.h", "stdlib.h", "string.h", "unistd.h", "errno.h", "limits.h"};
+static const char *types[] = {"int", "char", "long", "unsigned int", "short", "double", "float"};
+static const char *names[] = {"count", "len", "idx", "buf", "state", "offset", "value", "ptr", "total", "flags"};
+static const char *words[] = {"parse", "the", "next", "token", "and", "update", "state", "of", "buffer", "file"};
+
+#define NUM(a)	((int)(sizeof(a) / sizeof(a[0])))
+
+/********** Utility functions **********/
+
+/* small LCG, the corpus must not depend on the libc rand */
+static int pick(int n)
+{
+	seed = seed * 6364136223846793005ul + 1442695040888963407ul;
+	return (int)((seed >> 33) % n);
+}
+
+static void gen_comment(FILE *fp, int words_count)
+{
+	int idx;
+
+	if(pick(2))
+	{
+		fprintf(fp, "\t/*");
+		for(idx = 0; idx < words_count; idx++)
+			fprintf(fp, " %s%s", words[pick(NUM(words))], idx % 8 == 7 ? "\n\t *" : "");
+		fprintf(fp, " */\n");
+	}
+	else
+	{
+		fprintf(fp, "\t//");
+		for(idx = 0; idx < words_count; idx++)
+			fprintf(fp, " %s", words[pick(NUM(words))]);
+		fprintf(fp, "\n");
+	}
+}
+
+static void gen_statement(FILE *fp, int depth)
+{
+	const char *name = names[pick(NUM(names))];
+	int idx;
+
+	for(idx = 0; idx < depth; idx++)
+		fputc('\t', fp);
+
+	switch(pick(8))
+	{
+		case 0:
+			fprintf(fp, "%s = %s * %d + (%s >> %d);\n", name, names[pick(NUM(names))], pick(1000), name, pick(8));
+			break;
+		case 1:
+			fprintf(fp, "printf(\"%s %%d\\n\", %s);\n", words[pick(NUM(words))], name);
+			break;
+		case 2:
+			fprintf(fp, "if(%s == '%c')\n", name, 'a' + pick(26));
+			for(idx = 0; idx <= depth; idx++)
+				fputc('\t', fp);
+			fprintf(fp, "return %d;\n", pick(100));
+			break;
+		case 3:
+			fprintf(fp, "for(idx = 0; idx < %d; idx++)\n", pick(64));
+			for(idx = 0; idx <= depth; idx++)
+				fputc('\t', fp);
+			fprintf(fp, "%s += buf[idx];\n", name);
+			break;
+		case 4:
+			fprintf(fp, "while(%s != %d && %s < %d)\n", name, pick(10), names[pick(NUM(names))], pick(4096));
+			for(idx = 0; idx <= depth; idx++)
+				fputc('\t', fp);
+			fprintf(fp, "%s--;\n", name);
+			break;
+		case 5:
+			fprintf(fp, "%s = %s(\"%s\", sizeof(struct item));\n", name, words[pick(NUM(words))], words[pick(NUM(words))]);
+			break;
+		case 6:
+			fprintf(fp, "switch(%s)\n", name);
+			fprintf(fp, "%*s{\n", depth, "");
+			fprintf(fp, "%*s\tcase %d : break;\n", depth, "", pick(16));
+			fprintf(fp, "%*s\tdefault : %s = 0;\n", depth, "", name);
+			fprintf(fp, "%*s}\n", depth, "");
+			break;
+		default:
+			fprintf(fp, "%s %s_%d = %d;\n", types[pick(NUM(types))], name, pick(100), pick(100000));
+			break;
+	}
+}
+
+static void gen_file(const char *path, int functions, int file_idx)
+{
+	FILE *fp;
+	int idx, stmt;
+
+	if((fp = fopen(path, "w")) == NULL)
+	{
+		printf("Error! could not create %s\n", path);
+		exit(2);
+	}
+
+	fprintf(fp, "/* generated file %d */\n", file_idx);
+	for(idx = 0; idx < 3; idx++)
+		fprintf(fp, "#include <%s>\n", headers[pick(NUM(headers))]);
+	fprintf(fp, "#include \"file_%d.h\"\n\n", file_idx);
+	fprintf(fp, "#define MAX_%d\t%d\n\n", file_idx, pick(10000));
+	fprintf(fp, "struct item\n{\n\tint key;\n\tchar name[32];\n};\n\n");
+
+	for(idx = 0; idx < functions; idx++)
+	{
+		fprintf(fp, "static %s f%d_%d(%s %s, char *buf)\n{\n", types[pick(NUM(types))], file_idx, idx,
+				types[pick(NUM(types))], names[pick(NUM(names))]);
+		fprintf(fp, "\tint idx;\n");
+		for(stmt = 0; stmt < 4 + pick(12); stmt++)
+		{
+			if(pick(5) == 0)
+				gen_comment(fp, 4 + pick(20));
+			gen_statement(fp, 1 + pick(2));
+		}
+		fprintf(fp, "\treturn %d;\n}\n\n", pick(256));
+	}
+
+	fclose(fp);
+}
+
+int main(int argc, char *argv[])
+{
+	char path[PATH_MAX];
+	int files, functions, idx;
+
+	if(argc < 2)
+	{
+		printf("Usage: %s <directory> [files] [functions per file]\n", argv[0]);
+		return 1;
+	}
+	files = argc > 2 ? atoi(argv[2]) : 2000;
+	functions = argc > 3 ? atoi(argv[3]) : 20;
+
+	mkdir(argv[1], 0755);
+	for(idx = 0; idx < files; idx++)
+	{
+		snprintf(path, sizeof(path), "%s/d%d", argv[1], idx / CORPUS_DIR_FILES);
+		if(idx % CORPUS_DIR_FILES == 0)
+			mkdir(path, 0755);
+		snprintf(path, sizeof(path), "%s/d%d/f%d.c", argv[1], idx / CORPUS_DIR_FILES, idx);
+		gen_file(path, functions, idx);
+	}
+
+	return 0;
+}
+/**** End of file ****/
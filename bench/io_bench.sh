@@ -0,0 +1,49 @@
+#!/bin/sh
+# Compare the blocking and io_uring I/O backends of batch mode on a tree
+# of many small files.
+#
+# usage: bench/io_bench.sh <s2html binary> [number of files] [runs]
+#
+# Build the binary with io_uring support for the uring numbers:
+#   cmake -S . -B build -DS2HTML_IO_URING=ON && cmake --build build
+
+BIN=${1:?usage: $0 <s2html binary> [number of files] [runs]}
+FILES=${2:-50000}
+RUNS=${3:-3}
+TREE=$(mktemp -d "${TMPDIR:-/tmp}/s2html_io_bench.XXXXXX")
+
+trap 'rm -rf "$TREE"' EXIT
+
+# small C files, 100 per directory, contents differ a little per file
+awk -v n="$FILES" -v dir="$TREE" 'BEGIN {
+	for (i = 0; i < n; i++) {
+		if (i % 100 == 0)
+			system("mkdir -p " dir "/d" int(i / 100));
+		f = dir "/d" int(i / 100) "/f" i ".c";
+		print "/* generated file " i " */" > f;
+		print "#include <stdio.h>" > f;
+		print "#define VALUE " i > f;
+		print "" > f;
+		print "static int f" i "(int a)\n{" > f;
+		print "\tif(a > " i % 97 ")\n\t\treturn a * " i ";" > f;
+		print "\treturn 0;\n}" > f;
+		print "" > f;
+		print "int main(void)\n{\n\tchar c = \x27x\x27;\n\tprintf(\"%d %c\\n\", f" i "(VALUE), c);\n\treturn 0;\n}" > f;
+		close(f);
+	}
+}'
+
+echo "tree: $FILES files in $TREE"
+
+for backend in blocking uring; do
+	run=1
+	while [ "$run" -le "$RUNS" ]; do
+		# drop the previous outputs so every run writes new files
+		find "$TREE" -name '*.html' -delete
+		# and write back the dirty pages of earlier runs so they do not slow this one
+		sync
+		printf '%-9s run %d: ' "$backend" "$run"
+		"$BIN" --batch "$TREE" --io "$backend"
+		run=$((run + 1))
+	done
+done
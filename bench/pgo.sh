@@ -0,0 +1,82 @@
+#!/bin/sh
+# Two stage profile guided (PGO) + LTO release build, timed against a
+# plain -O2 build of the same sources.
+#
+# Stage 1 builds an instrumented binary and trains it on a generated C
+# corpus, stage 2 rebuilds the same tree with the recorded profiles.
+#
+# usage: bench/pgo.sh <source dir> <work dir> <gen_corpus binary> [cmake] [files] [runs]
+# or from a configured build: cmake --build <build dir> --target pgo
+
+SRC=${1:?usage: $0 <source dir> <work dir> <gen_corpus binary> [cmake] [files] [runs]}
+WORK=${2:?usage: $0 <source dir> <work dir> <gen_corpus binary> [cmake] [files] [runs]}
+GEN=${3:?usage: $0 <source dir> <work dir> <gen_corpus binary> [cmake] [files] [runs]}
+CMAKE=${4:-cmake}
+FILES=${5:-2000}
+RUNS=${6:-3}
+
+set -e
+mkdir -p "$WORK"
+WORK=$(cd "$WORK" && pwd)
+CORPUS=$WORK/corpus
+PROFILE=$WORK/profile
+
+# the corpus: a tree for batch mode and one big file for the single file path
+rm -rf "$CORPUS"
+"$GEN" "$CORPUS" "$FILES" 20
+find "$CORPUS" -name '*.c' -exec cat {} + > "$WORK/big.c"
+
+workload()
+{
+	"$1" --batch "$CORPUS" --io blocking > /dev/null
+	"$1" --jobs 1 "$WORK/big.c" "$WORK/big" > /dev/null
+}
+
+# best wall time of the workload in ms
+best_ms()
+{
+	best=
+	run=0
+	while [ $run -lt "$RUNS" ]; do
+		start=$(date +%s%N)
+		workload "$1"
+		ms=$(( ($(date +%s%N) - start) / 1000000 ))
+		if [ -z "$best" ] || [ "$ms" -lt "$best" ]; then
+			best=$ms
+		fi
+		run=$((run + 1))
+	done
+	echo "$best"
+}
+
+echo "== plain -O2 build"
+# an empty build type would be turned into Release by CMakeLists.txt, None
+# adds no flags of its own
+"$CMAKE" -S "$SRC" -B "$WORK/o2" -DCMAKE_BUILD_TYPE=None -DCMAKE_C_FLAGS=-O2 -DS2HTML_LTO=OFF > /dev/null
+"$CMAKE" --build "$WORK/o2" --target s2html > /dev/null
+
+echo "== stage 1: instrumented build"
+rm -rf "$PROFILE"
+"$CMAKE" -S "$SRC" -B "$WORK/release" -DCMAKE_BUILD_TYPE=Release -DS2HTML_PGO=generate \
+	-DS2HTML_PGO_DIR="$PROFILE" > /dev/null
+"$CMAKE" --build "$WORK/release" --target s2html > /dev/null
+
+echo "== training on $FILES files"
+workload "$WORK/release/s2html"
+
+# clang writes raw profiles that have to be merged first
+if ls "$PROFILE"/*.profraw > /dev/null 2>&1; then
+	llvm-profdata merge -o "$PROFILE/default.profdata" "$PROFILE"/*.profraw
+fi
+
+echo "== stage 2: optimized build"
+"$CMAKE" -S "$SRC" -B "$WORK/release" -DCMAKE_BUILD_TYPE=Release -DS2HTML_PGO=use > /dev/null
+"$CMAKE" --build "$WORK/release" --target s2html > /dev/null
+
+O2_MS=$(best_ms "$WORK/o2/s2html")
+PGO_MS=$(best_ms "$WORK/release/s2html")
+
+echo "-O2          : $O2_MS ms"
+echo "PGO + LTO    : $PGO_MS ms"
+awk -v a="$O2_MS" -v b="$PGO_MS" 'BEGIN { if (b > 0) printf("speedup      : %.2fx\n", a / b) }'
+echo "release binary: $WORK/release/s2html"
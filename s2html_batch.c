@@ -0,0 +1,277 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <ftw.h>
+#include <unistd.h>
+#include "s2html_event.h"
+#include "s2html_conv.h"
+#include "s2html_lang.h"
+#include "s2html_io.h"
+#include "s2html_index.h"
+#include "s2html_batch.h"
+#include "s2html_cache.h"
+#include "s2html_trace.h"
+#include "s2html_shard.h"
+
+//structure to hold the context of a batch run that builds the search index
+typedef struct
+{
+	index_builder_t *idx;
+	const char *dir;        // files are indexed by their path below dir
+}batch_index_t;
+
+/* list filled by the nftw callback */
+static batch_list_t *collect_list = NULL;
+
+/********** Utility functions **********/
+
+/* nftw callback: remember every file of a known language */
+static int batch_add_entry(const char *path, const struct stat *sb, int flag, struct FTW *ftwbuf)
+{
+	batch_list_t *list = collect_list;
+	char **files;
+	long *sizes;
+
+	(void)ftwbuf;
+
+	if(flag != FTW_F || lang_lookup(path) == NULL)
+		return 0;
+
+	if(list->count == list->size)
+	{
+		int size = list->size ? list->size * 2 : 256;
+
+		if((files = realloc(list->files, size * sizeof(char *))) == NULL)
+			return -1;
+		list->files = files;
+		if((sizes = realloc(list->sizes, size * sizeof(long))) == NULL)
+			return -1;
+		list->sizes = sizes;
+		list->size = size;
+	}
+
+	list->files[list->count] = strdup(path);
+	list->sizes[list->count] = sb->st_size;
+	list->count++;
+
+	return 0;
+}
+
+/* sort helper: order files and sizes together by path */
+static int batch_cmp_path(const void *a, const void *b)
+{
+	return strcmp(**(char ***)a, **(char ***)b);
+}
+
+/* render function of a plain batch run */
+static int batch_render(const char *src_file, const char *buf, size_t len, FILE *dfp, void *ctx)
+{
+	(void)ctx;
+	return convert_buffer(src_file, buf, len, dfp, NULL, NULL);
+}
+
+/* render function of a batch run that also builds the search index */
+static int batch_render_index(const char *src_file, const char *buf, size_t len, FILE *dfp, void *ctx)
+{
+	batch_index_t *bi = ctx;
+
+	index_begin_file(bi->idx, batch_rel_path(bi->dir, src_file));
+	return convert_buffer(src_file, buf, len, dfp, index_add_event, bi->idx);
+}
+
+/* render function of a batch run with the fragment cache */
+static int batch_render_cache(const char *src_file, const char *buf, size_t len, FILE *dfp, void *ctx)
+{
+	return cache_convert_buffer(ctx, src_file, buf, len, dfp);
+}
+
+/* hit rate of the fragment cache and the time it saved */
+static void batch_print_cache(cache_t *cache)
+{
+	cache_stats_t stats;
+	double saved = 0;
+
+	cache_get_stats(cache, &stats);
+
+	/* a hit saves what lexing and rendering its bytes costs on a miss */
+	if(stats.miss_bytes)
+		saved = stats.hit_bytes * (stats.miss_ms / stats.miss_bytes) - stats.hit_ms;
+
+	printf("Fragment cache: %.1f%% hits (%ld of %ld blocks, %.1f KB of source), about %.1f ms saved, "
+			"%.1f of %.1f MB used%s\n",
+			stats.lookups ? 100.0 * stats.hits / stats.lookups : 0.0, stats.hits, stats.lookups,
+			stats.hit_bytes / 1024.0, saved, stats.used / 1048576.0, stats.max / 1048576.0,
+			stats.rejected ? " (full)" : "");
+}
+
+/********** batch functions **********/
+
+int batch_collect(const char *dir, batch_list_t *list)
+{
+	char ***order;
+	char **files;
+	long *sizes;
+	int idx;
+
+	memset(list, 0, sizeof(batch_list_t));
+	collect_list = list;
+	if(nftw(dir, batch_add_entry, 16, FTW_PHYS) != 0)
+		return -1;
+	collect_list = NULL;
+
+	/* sort by path so that every run sees the same order */
+	order = malloc(list->count * sizeof(char **));
+	files = malloc(list->count * sizeof(char *));
+	sizes = malloc(list->count * sizeof(long));
+	if(list->count && (order == NULL || files == NULL || sizes == NULL))
+		return -1;
+
+	for(idx = 0; idx < list->count; idx++)
+		order[idx] = &list->files[idx];
+	qsort(order, list->count, sizeof(char **), batch_cmp_path);
+	for(idx = 0; idx < list->count; idx++)
+	{
+		files[idx] = *order[idx];
+		sizes[idx] = list->sizes[order[idx] - list->files];
+	}
+
+	free(order);
+	free(list->files);
+	free(list->sizes);
+	list->files = files;
+	list->sizes = sizes;
+	list->size = list->count;
+
+	return 0;
+}
+
+/* nftw gives every path as dir (however it was typed) followed by the
+ * path below it, the part below dir is the same for every spelling of dir
+ */
+const char *batch_rel_path(const char *dir, const char *path)
+{
+	path += strlen(dir);
+	while(*path == '/')
+		path++;
+
+	return path;
+}
+
+void batch_free(batch_list_t *list)
+{
+	int idx;
+
+	for(idx = 0; idx < list->count; idx++)
+		free(list->files[idx]);
+	free(list->files);
+	free(list->sizes);
+	memset(list, 0, sizeof(batch_list_t));
+}
+
+/* convert every source file below dir into <file>.html */
+int batch_run(const char *dir, const batch_opts_t *opts)
+{
+	batch_list_t list;
+	io_stats_t stats;
+	index_builder_t *idx = NULL;
+	batch_index_t bi;
+	cache_t *cache = NULL;
+	io_render_fn render = batch_render;
+	void *ctx = NULL;
+	char index_file[PATH_MAX];
+	uint64_t start;
+	int backend, ret, written;
+
+	start = trace_begin("collect", dir);
+	ret = batch_collect(dir, &list);
+	trace_end("collect", dir, start);
+	if(ret < 0)
+	{
+		printf("Error! could not read directory %s\n", dir);
+		batch_free(&list);
+		return 2;
+	}
+
+	/* the other shards are rendered by other processes */
+	if(opts->shards)
+		shard_select(dir, &list, opts->shard, opts->shards);
+
+	if(opts->index && (idx = index_create()) == NULL)
+	{
+		batch_free(&list);
+		return 4;
+	}
+
+	/* the index needs every event, so it does without the cache */
+	if(idx)
+	{
+		bi.idx = idx;
+		bi.dir = dir;
+		render = batch_render_index;
+		ctx = &bi;
+	}
+	else if(opts->cache_mb > 0 && (cache = cache_create((size_t)opts->cache_mb * 1024 * 1024)) != NULL)
+	{
+		render = batch_render_cache;
+		ctx = cache;
+	}
+
+	backend = io_convert_files(list.files, list.sizes, list.count, opts->io_backend,
+			render, ctx, &stats);
+
+	printf("Converted %ld files (%ld failed), %.1f KB -> %.1f KB in %.1f ms using %s I/O\n",
+			stats.files, stats.failed, stats.bytes_in / 1024.0, stats.bytes_out / 1024.0,
+			stats.msec, io_backend_name(backend));
+	ret = stats.failed ? 3 : 0;
+
+	if(cache)
+	{
+		batch_print_cache(cache);
+		cache_destroy(cache);
+	}
+
+	if(idx)
+	{
+		if(opts->shards)
+			shard_file(index_file, sizeof(index_file), dir, opts->shard, opts->shards, "idx");
+		else
+			snprintf(index_file, sizeof(index_file), "%s/%s", dir, INDEX_FILE_NAME);
+		start = trace_begin("index write", index_file);
+		written = index_write(idx, index_file);
+		trace_end("index write", index_file, start);
+		if(written < 0)
+		{
+			printf("Error! could not create %s index file\n", index_file);
+			ret = 3;
+		}
+		else
+			printf("Index file %s generated\n", index_file);
+		index_destroy(idx);
+	}
+
+	/* the manifest tells the merge that this shard is done, failed files included */
+	if(opts->shards)
+	{
+		/* a partial index of an earlier run would be merged with this one */
+		if(idx == NULL)
+		{
+			shard_file(index_file, sizeof(index_file), dir, opts->shard, opts->shards, "idx");
+			unlink(index_file);
+		}
+		if(shard_write_manifest(dir, opts->shard, opts->shards, &list, &stats) < 0)
+		{
+			printf("Error! could not create the manifest of shard %d/%d\n", opts->shard, opts->shards);
+			ret = 3;
+		}
+		else
+			printf("Shard %d/%d done, combine the shards with --merge %s %d\n",
+					opts->shard, opts->shards, dir, opts->shards);
+	}
+
+	batch_free(&list);
+
+	return ret;
+}
+/**** End of file ****/
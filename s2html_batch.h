@@ -0,0 +1,31 @@
+#ifndef S2HTML_BATCH_H
+#define S2HTML_BATCH_H
+
+//structure to hold the source files of a tree
+typedef struct
+{
+	char **files;  // source file paths, sorted
+	long *sizes;   // file sizes in bytes
+	int count;     // number of files
+	int size;      // allocated entries
+}batch_list_t;
+
+//structure to hold the options of a batch run
+typedef struct
+{
+	int io_backend; // IO_BACKEND_*
+	int index;      // also write a search index of the tree
+	int cache_mb;   // memory cap of the fragment cache, 0 => no cache
+	int shard;      // this run converts shard of shards
+	int shards;     // 0 => the whole tree
+}batch_opts_t;
+
+/********** function prototypes **********/
+
+int batch_collect(const char *dir, batch_list_t *list); /* every source file below dir */
+const char *batch_rel_path(const char *dir, const char *path); /* path of a collected file relative to dir */
+void batch_free(batch_list_t *list);
+int batch_run(const char *dir, const batch_opts_t *opts); /* convert the tree, returns exit code */
+
+#endif
+/**** End of file ****/
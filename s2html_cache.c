@@ -0,0 +1,325 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include "s2html_event.h"
+#include "s2html_conv.h"
+#include "s2html_lang.h"
+#include "s2html_cache.h"
+
+//structure to hold one rendered block
+typedef struct cache_entry
+{
+	uint64_t hash;
+	const lang_t *lang;         // the same text renders differently per language
+	size_t src_len;
+	size_t html_len;
+	struct cache_entry *next;   // hash chain
+	char data[];                // source then html
+}cache_entry_t;
+
+//structure to hold one lock and its chains
+typedef struct
+{
+	pthread_mutex_t lock;
+	cache_entry_t *buckets[CACHE_BUCKETS];
+}cache_shard_t;
+
+struct cache
+{
+	cache_shard_t shards[CACHE_SHARDS];
+	size_t max;                 // memory cap
+	size_t used;                // updated atomically
+	long lookups, hits, hit_bytes, inserts, rejected, miss_bytes;
+	uint64_t miss_ns, hit_ns;
+};
+
+//structure to hold html rendered but not written yet
+typedef struct
+{
+	char *buf;
+	size_t len;
+	size_t size;
+}cache_out_t;
+
+/********** Utility functions **********/
+
+static uint64_t cache_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/* FNV-1a */
+static uint64_t cache_hash(const char *data, size_t len)
+{
+	uint64_t hash = 14695981039346656037ull;
+	size_t idx;
+
+	for(idx = 0; idx < len; idx++)
+	{
+		hash ^= (unsigned char)data[idx];
+		hash *= 1099511628211ull;
+	}
+
+	return hash;
+}
+
+#define CACHE_ADD(field, value)	__atomic_fetch_add(&cache->field, value, __ATOMIC_RELAXED)
+
+/* entries are never changed or freed before cache_destroy, so the
+ * caller may use the entry without the lock
+ */
+static cache_entry_t *cache_lookup(cache_t *cache, uint64_t hash, const lang_t *lang,
+		const char *src, size_t src_len)
+{
+	cache_shard_t *shard = &cache->shards[hash % CACHE_SHARDS];
+	cache_entry_t *entry;
+
+	pthread_mutex_lock(&shard->lock);
+	for(entry = shard->buckets[(hash / CACHE_SHARDS) % CACHE_BUCKETS]; entry; entry = entry->next)
+	{
+		if(entry->hash == hash && entry->lang == lang && entry->src_len == src_len &&
+				memcmp(entry->data, src, src_len) == 0)
+			break;
+	}
+	pthread_mutex_unlock(&shard->lock);
+
+	return entry;
+}
+
+static void cache_insert(cache_t *cache, uint64_t hash, const lang_t *lang,
+		const char *src, size_t src_len, const char *html, size_t html_len)
+{
+	cache_shard_t *shard = &cache->shards[hash % CACHE_SHARDS];
+	cache_entry_t *entry, **bucket;
+	size_t need = sizeof(cache_entry_t) + src_len + html_len;
+
+	/* once full, the cache keeps what it has */
+	if(CACHE_ADD(used, need) + need > cache->max || (entry = malloc(need)) == NULL)
+	{
+		CACHE_ADD(used, -need);
+		CACHE_ADD(rejected, 1);
+		return;
+	}
+	entry->hash = hash;
+	entry->lang = lang;
+	entry->src_len = src_len;
+	entry->html_len = html_len;
+	memcpy(entry->data, src, src_len);
+	memcpy(entry->data + src_len, html, html_len);
+
+	pthread_mutex_lock(&shard->lock);
+	bucket = &shard->buckets[(hash / CACHE_SHARDS) % CACHE_BUCKETS];
+	entry->next = *bucket;
+	*bucket = entry;
+	pthread_mutex_unlock(&shard->lock);
+
+	CACHE_ADD(inserts, 1);
+}
+
+/* render the event at the end of out */
+static int cache_put_event(cache_out_t *out, pevent_t *event)
+{
+	size_t len = token_html_length(event->type, event->property, event->data, event->length);
+	size_t size = out->size;
+	char *buf;
+
+	if(out->len + len > out->size)
+	{
+		size = size ? size * 2 : 64 * 1024;
+		while(out->len + len > size)
+			size *= 2;
+		if((buf = realloc(out->buf, size)) == NULL)
+			return -1;
+		out->buf = buf;
+		out->size = size;
+	}
+	token_to_html(out->buf + out->len, event->type, event->property, event->data, event->length);
+	out->len += len;
+
+	return 0;
+}
+
+/* start of the block after pos: just after the next blank line, len if none */
+static size_t cache_next_block(const char *buf, size_t len, size_t pos)
+{
+	const char *p;
+
+	for(p = buf + pos; (p = memchr(p, '\n', buf + len - p)) != NULL && p + 1 < buf + len; p++)
+	{
+		if(p[1] == '\n')
+			return p + 2 - buf;
+	}
+
+	return len;
+}
+
+/* lex and render from the stream position, a block between two
+ * blank lines is served from the cache when the parser is idle at
+ * its start, and added to it when the parser is idle at its end
+ */
+static int cache_convert_stream(cache_t *cache, const char *buf, size_t len, FILE *sfp, FILE *dfp)
+{
+	const lang_t *lang = lang_current();
+	cache_out_t out = {NULL, 0, 0};
+	cache_entry_t *entry;
+	pevent_t *event;
+	uint64_t hash = 0, start = 0;
+	size_t pos = 0, block = 0, block_end = 0;
+	size_t rec_block = 0, rec_start = 0;    // source and html offsets of the recorded block
+	int recording = 0, idle = 1, ret = CONV_OK;
+
+	while(ret == CONV_OK)
+	{
+		/* skip the blocks the parser has passed inside a token */
+		while(block < pos)
+			block = cache_next_block(buf, len, block);
+
+		if(idle && pos == block && !recording)
+		{
+			block_end = cache_next_block(buf, len, pos);
+			if(block_end < len && block_end - pos >= CACHE_MIN_BLOCK)
+			{
+				start = cache_now();
+				hash = cache_hash(buf + pos, block_end - pos);
+				CACHE_ADD(lookups, 1);
+				if((entry = cache_lookup(cache, hash, lang, buf + pos, block_end - pos)) != NULL)
+				{
+					fwrite(out.buf, 1, out.len, dfp);
+					out.len = 0;
+					fwrite(entry->data + entry->src_len, 1, entry->html_len, dfp);
+					fseek(sfp, block_end, SEEK_SET);
+					CACHE_ADD(hits, 1);
+					CACHE_ADD(hit_bytes, block_end - pos);
+					CACHE_ADD(hit_ns, cache_now() - start);
+					pos = block_end;
+					continue;
+				}
+				recording = 1;
+				rec_block = pos;
+				rec_start = out.len;
+			}
+			else
+				block = block_end;
+		}
+
+		event = get_parser_event(sfp);
+		if(cache_put_event(&out, event) < 0)
+			ret = CONV_ERR_DEST;
+		if(event->type == PEVENT_EOF)
+			break;
+
+		/* html before an idle point is final */
+		if(!recording && out.len >= CACHE_FLUSH_SIZE)
+		{
+			fwrite(out.buf, 1, out.len, dfp);
+			out.len = 0;
+		}
+
+		/* a block can only end right after a new line */
+		if(event->length == 0 || event->data[event->length - 1] != '\n')
+		{
+			idle = 0;
+			continue;
+		}
+		pos = ftell(sfp);
+		idle = parser_is_idle();
+
+		if(recording && pos >= block_end)
+		{
+			if(pos == block_end && idle)
+			{
+				cache_insert(cache, hash, lang, buf + rec_block, block_end - rec_block,
+						out.buf + rec_start, out.len - rec_start);
+				CACHE_ADD(miss_bytes, block_end - rec_block);
+				CACHE_ADD(miss_ns, cache_now() - start);
+			}
+			recording = 0;
+		}
+	}
+
+	fwrite(out.buf, 1, out.len, dfp);
+	free(out.buf);
+
+	return ret;
+}
+
+/********** cache functions **********/
+
+cache_t *cache_create(size_t max_bytes)
+{
+	cache_t *cache;
+	int idx;
+
+	if((cache = calloc(1, sizeof(cache_t))) == NULL)
+		return NULL;
+	for(idx = 0; idx < CACHE_SHARDS; idx++)
+		pthread_mutex_init(&cache->shards[idx].lock, NULL);
+	cache->max = max_bytes;
+
+	return cache;
+}
+
+void cache_destroy(cache_t *cache)
+{
+	cache_entry_t *entry, *next;
+	int idx, bucket;
+
+	for(idx = 0; idx < CACHE_SHARDS; idx++)
+	{
+		for(bucket = 0; bucket < CACHE_BUCKETS; bucket++)
+		{
+			for(entry = cache->shards[idx].buckets[bucket]; entry; entry = next)
+			{
+				next = entry->next;
+				free(entry);
+			}
+		}
+		pthread_mutex_destroy(&cache->shards[idx].lock);
+	}
+	free(cache);
+}
+
+int cache_convert_buffer(cache_t *cache, const char *src_file, const char *buf, size_t len, FILE *dfp)
+{
+	FILE *sfp = NULL;
+	int ret = CONV_OK;
+
+	/* an empty file has nothing to parse */
+	if(len && NULL == (sfp = fmemopen((void *)buf, len, "r")))
+		return CONV_ERR_SOURCE;
+
+	lang_select(src_file);
+	reset_parser();
+
+	html_begin(dfp, HTML_OPEN);
+	if(sfp)
+	{
+		ret = cache_convert_stream(cache, buf, len, sfp, dfp);
+		fclose(sfp);
+	}
+	html_end(dfp, HTML_CLOSE);
+
+	return ret;
+}
+
+void cache_get_stats(cache_t *cache, cache_stats_t *stats)
+{
+	stats->lookups = __atomic_load_n(&cache->lookups, __ATOMIC_RELAXED);
+	stats->hits = __atomic_load_n(&cache->hits, __ATOMIC_RELAXED);
+	stats->hit_bytes = __atomic_load_n(&cache->hit_bytes, __ATOMIC_RELAXED);
+	stats->inserts = __atomic_load_n(&cache->inserts, __ATOMIC_RELAXED);
+	stats->rejected = __atomic_load_n(&cache->rejected, __ATOMIC_RELAXED);
+	stats->miss_bytes = __atomic_load_n(&cache->miss_bytes, __ATOMIC_RELAXED);
+	stats->miss_ms = __atomic_load_n(&cache->miss_ns, __ATOMIC_RELAXED) / 1e6;
+	stats->hit_ms = __atomic_load_n(&cache->hit_ns, __ATOMIC_RELAXED) / 1e6;
+	stats->used = __atomic_load_n(&cache->used, __ATOMIC_RELAXED);
+	stats->max = cache->max;
+}
+/**** End of file ****/
@@ -0,0 +1,45 @@
+#ifndef S2HTML_CACHE_H
+#define S2HTML_CACHE_H
+
+#include <stdio.h>
+
+/* constants */
+
+#define CACHE_SHARDS		64   /* locks of the cache, picked by hash */
+#define CACHE_BUCKETS		1024 /* hash chains per shard */
+#define CACHE_MIN_BLOCK		32   /* smaller blocks are just lexed */
+#define CACHE_DEFAULT_MB	64
+#define CACHE_FLUSH_SIZE	(64 * 1024) /* rendered html written in pieces of this size */
+
+//structure to hold the counters of a cache
+typedef struct
+{
+	long lookups;       // blocks looked up
+	long hits;          // blocks copied from the cache
+	long hit_bytes;     // source bytes of the hits
+	long inserts;       // blocks added
+	long rejected;      // blocks not added because the cache was full
+	long miss_bytes;    // source bytes of blocks lexed and rendered
+	double miss_ms;     // time spent lexing and rendering them
+	double hit_ms;      // time spent on hits
+	size_t used;        // bytes held
+	size_t max;         // memory cap
+}cache_stats_t;
+
+//structure to hold the rendered html of source blocks, shared by threads
+typedef struct cache cache_t;
+
+/********** function prototypes **********/
+
+cache_t *cache_create(size_t max_bytes);
+void cache_destroy(cache_t *cache);
+
+/* same output as convert_buffer without hook, blocks of source between blank
+ * lines that start and end outside of any token are taken from the cache
+ */
+int cache_convert_buffer(cache_t *cache, const char *src_file, const char *buf, size_t len, FILE *dfp);
+
+void cache_get_stats(cache_t *cache, cache_stats_t *stats);
+
+#endif
+/**** End of file ****/
@@ -1,10 +1,20 @@
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/stat.h>
 #include "s2html_event.h"
 #include "s2html_conv.h"
+#include "s2html_lang.h"
+#include "s2html_trace.h"
+
+/* counter to give temporary output files unique names */
+static unsigned long tmp_file_count = 0;
 
 /* start_or_end_conv function definitation */
-void html_begin(FILE* dest_fp, int type) /* type => not used, but can be used to add differnet HTML tags */
+void html_begin(FILE* dest_fp, int type) /* type => HTML_OPEN for a page, HTML_DIFF for a side by side diff page */
 {
 	/* Add HTML begining tags into destination file */
 	fprintf(dest_fp, "<!DOCTYPE html>\n");
@@ -15,80 +25,315 @@ void html_begin(FILE* dest_fp, int type) /* type => not used, but can be used to
 	fprintf(dest_fp, "<link rel=\"stylesheet\" href=\"styles.css\">\n");
 	fprintf(dest_fp, "</head>\n");
 	fprintf(dest_fp, "<body style=\"background-color:lightgrey;\">\n");
+	if(type == HTML_DIFF)
+		fprintf(dest_fp, "<table class=\"diff\"><tr><td>\n");
 	fprintf(dest_fp, "<pre>\n");
 }
 
 //eend the html file
-void html_end(FILE* dest_fp, int type) /* type => not used, but can be used to add differnet HTML tags */
+void html_end(FILE* dest_fp, int type) /* type => HTML_CLOSE for a page, HTML_DIFF for a side by side diff page */
 {
 	/* Add HTML closing tags into destination file */
 	fprintf(dest_fp, "</pre>\n");
+	if(type == HTML_DIFF)
+		fprintf(dest_fp, "</td></tr></table>\n");
 	fprintf(dest_fp, "</body>\n");
 	fprintf(dest_fp, "</html>\n");
 }
 
+/* css class used for the event, NULL for plain text and unknown events */
+const char *event_class(const pevent_t *event)
+{
+	return type_class(event->type, event->property);
+}
 
-/* sourc_to_html function definitation */
-void source_to_html(FILE* fp, pevent_t *event)
+/* css class used for an event type and property */
+const char *type_class(pevent_e type, int property)
 {
-#ifdef DEBUG
-	printf("%s", event -> data);
-#endif
-   
-   //printf("%s\n" , event -> data); 
-    
-    //to check what type of event is obtained and print accordingly to the html file
-	switch(event -> type)
+	switch(type)
 	{
 		case PEVENT_PREPROCESSOR_DIRECTIVE:
-			fprintf(fp,"<span class=\"preprocess_dir\">%s</span>",event->data);
-			break;
+			return "preprocess_dir";
 
 		case PEVENT_MULTI_LINE_COMMENT:
 		case PEVENT_SINGLE_LINE_COMMENT:
-			fprintf(fp,"<span class=\"comment\">%s</span>",event->data);
-			break;
+			return "comment";
 
 		case PEVENT_STRING:
-			fprintf(fp,"<span class=\"string\">%s</span>",event->data);
-			break;
+			return "string";
 
 		case PEVENT_HEADER_FILE:
-			/* write to html */
-			if(event->property == USER_HEADER_FILE)
-				fprintf(fp,"<span class=\"header_file\">%s</span>",event->data);
-			else
-				fprintf(fp,"<span class=\"header_file\">&lt;%s&gt;</span>",event->data);
-			break;
-
-		case PEVENT_REGULAR_EXP:
-		case PEVENT_EOF :
-			fprintf(fp,"%s",event->data);
-			break;
-            
+			return "header_file";
+
 		case PEVENT_NUMERIC_CONSTANT:
-			fprintf(fp,"<span class=\"numeric_constant\">%s</span>",event->data);
-			break;
+			return "numeric_constant";
 
 		case PEVENT_RESERVE_KEYWORD:
-			if(event->property == RES_KEYWORD_DATA)
-			{
-				fprintf(fp,"<span class=\"reserved_key1\">%s</span>",event->data);
-			}
-			else
-			{
-				fprintf(fp,"<span class=\"reserved_key2\">%s</span>",event->data);
-			}
-			break;
+			if(property == RES_KEYWORD_DATA)
+				return "reserved_key1";
+			return "reserved_key2";
 
 		case PEVENT_ASCII_CHAR:
-			fprintf(fp,"<span class=\"ascii_char\">%s</span>",event->data);
-			break;
+			return "ascii_char";
 
 		default :
+			return NULL;
+	}
+}
+
+/* sourc_to_html function definitation */
+void source_to_html(FILE* fp, pevent_t *event)
+{
+	source_to_html_mark(fp, event, NULL);
+}
+
+/* write the event with an extra css class (like diff_ins), mark may be NULL */
+void source_to_html_mark(FILE* fp, pevent_t *event, const char *mark)
+{
+	const char *cls = NULL;
+
+#ifdef DEBUG
+	printf("%s", event -> data);
+#endif
+
+	if(event->type != PEVENT_REGULAR_EXP && event->type != PEVENT_EOF)
+	{
+		if((cls = event_class(event)) == NULL)
+		{
 			printf("Unknow event\n");
-			break;
+			return;
+		}
+	}
+
+	/* plain text is written as it is */
+	if(cls == NULL && mark == NULL)
+	{
+		fprintf(fp,"%s",event->data);
+		return;
+	}
+
+	fprintf(fp, "<span class=\"%s%s%s\">", cls ? cls : "", (cls && mark) ? " " : "", mark ? mark : "");
+	if(event->type == PEVENT_HEADER_FILE && event->property != USER_HEADER_FILE)
+		fprintf(fp, "&lt;%s&gt;", event->data);
+	else
+		fprintf(fp, "%s", event->data);
+	fprintf(fp, "</span>");
+}
+
+/* number of bytes source_to_html writes for the token */
+size_t token_html_length(pevent_e type, int property, const char *data, int length)
+{
+	const char *cls;
+	size_t len = strnlen(data, length); // data is written with %s
+
+	if(type == PEVENT_REGULAR_EXP || type == PEVENT_EOF)
+		return len;
+	if((cls = type_class(type, property)) == NULL)
+		return 0;
+
+	len += sizeof("<span class=\"\">") - 1 + strlen(cls) + sizeof("</span>") - 1;
+	if(type == PEVENT_HEADER_FILE && property != USER_HEADER_FILE)
+		len += sizeof("&lt;&gt;") - 1;
+
+	return len;
+}
+
+/* write the same bytes as source_to_html into memory, returns the end of the written bytes */
+char *token_to_html(char *dst, pevent_e type, int property, const char *data, int length)
+{
+	const char *cls;
+	size_t len = strnlen(data, length);
+
+#define PUT(s, n)	(memcpy(dst, (s), (n)), dst += (n))
+	if(type == PEVENT_REGULAR_EXP || type == PEVENT_EOF)
+	{
+		PUT(data, len);
+		return dst;
+	}
+	if((cls = type_class(type, property)) == NULL)
+		return dst;
+
+	PUT("<span class=\"", 13);
+	PUT(cls, strlen(cls));
+	PUT("\">", 2);
+	if(type == PEVENT_HEADER_FILE && property != USER_HEADER_FILE)
+	{
+		PUT("&lt;", 4);
+		PUT(data, len);
+		PUT("&gt;", 4);
+	}
+	else
+		PUT(data, len);
+	PUT("</span>", 7);
+#undef PUT
+
+	return dst;
+}
 
+/* name of the temporary file used while writing dest_file */
+void conv_tmp_name(char *tmp_file, size_t size, const char *dest_file)
+{
+	snprintf(tmp_file, size, "%s.%d.%lu.tmp", dest_file, (int)getpid(),
+			__atomic_fetch_add(&tmp_file_count, 1, __ATOMIC_RELAXED));
+}
+
+/* under --trace the source is read whole in a "read" phase and lexed from
+ * memory, else the reads would hide in the lexing time, on failure the
+ * file stream is lexed as it is
+ */
+static FILE *conv_read_source(const char *src_file, FILE *sfp, char **buf)
+{
+	uint64_t start = trace_begin("read", src_file);
+	size_t len = 0, cap, got;
+	struct stat st;
+	char *grown;
+	FILE *mfp;
+
+	cap = (fstat(fileno(sfp), &st) == 0 ? (size_t)st.st_size : 0) + 1;
+	*buf = malloc(cap);
+	while(*buf && (got = fread(*buf + len, 1, cap - len, sfp)) > 0)
+	{
+		/* the file grew since fstat */
+		if((len += got) == cap)
+		{
+			if((grown = realloc(*buf, cap * 2)) == NULL)
+				break;
+			*buf = grown;
+			cap *= 2;
+		}
+	}
+	trace_end("read", src_file, start);
+
+	/* an empty file has nothing to parse, the file stream serves as well */
+	if(*buf == NULL || len == 0 || ferror(sfp) || (mfp = fmemopen(*buf, len, "r")) == NULL)
+	{
+		free(*buf);
+		*buf = NULL;
+		rewind(sfp);
+		return sfp;
+	}
+	fclose(sfp);
+
+	return mfp;
+}
+
+/* the get_parser_event loop of convert_stream as one "convert" phase, the
+ * events are too many to record one by one: the time spent lexing and
+ * rendering them is summed into the args of the phase
+ */
+static void convert_stream_traced(const char *src_file, FILE *sfp, FILE *dfp, conv_hook_fn hook, void *ctx)
+{
+	static const char *const names[2] = {"get_parser_event", "source_to_html"};
+	pevent_t *event;
+	uint64_t start = trace_begin("convert", src_file), sums[2] = {0, 0}, t0, t1;
+
+	do
+	{
+		t0 = trace_now();
+		event = get_parser_event(sfp);
+		t1 = trace_now();
+		if(hook)
+			hook(ctx, event);
+		source_to_html(dfp, event);
+		sums[0] += t1 - t0;
+		sums[1] += trace_now() - t1;
+	} while (event->type != PEVENT_EOF);
+
+	trace_end_sums("convert", src_file, start, names, sums, 2);
+}
+
+/* parse the source stream and write the whole html page,
+ * hook (if not NULL) sees every event before it is written
+ */
+static void convert_stream(const char *src_file, FILE *sfp, FILE *dfp, conv_hook_fn hook, void *ctx)
+{
+	pevent_t *event;
+
+	/* fresh parser for this file */
+	lang_select(src_file);
+	reset_parser();
+
+	html_begin(dfp, HTML_OPEN);
+	if(sfp && trace_enabled)
+	{
+		convert_stream_traced(src_file, sfp, dfp, hook, ctx);
 	}
+	else if(sfp)
+	{
+		do
+		{
+			event = get_parser_event(sfp);
+			if(hook)
+				hook(ctx, event);
+			source_to_html(dfp, event);
+		} while (event->type != PEVENT_EOF);
+	}
+	html_end(dfp, HTML_CLOSE);
 }
 
+/* convert one source file into html
+ * output is written to a temporary file first and renamed to
+ * dest_file, so readers never see a half written file
+ */
+int convert_file(const char *src_file, const char *dest_file)
+{
+	FILE *sfp, *dfp; // source and destination file descriptors
+	char tmp_file[PATH_MAX], *src_buf = NULL;
+	uint64_t start;
+	int ret;
+
+	start = trace_begin("open", src_file);
+	if(NULL == (sfp = fopen(src_file, "r")))
+	{
+		trace_end("open", src_file, start);
+		return CONV_ERR_SOURCE;
+	}
+
+	conv_tmp_name(tmp_file, sizeof(tmp_file), dest_file);
+	dfp = fopen(tmp_file, "w");
+	trace_end("open", src_file, start);
+	if(NULL == dfp)
+	{
+		fclose(sfp);
+		return CONV_ERR_DEST;
+	}
+
+	if(trace_enabled)
+		sfp = conv_read_source(src_file, sfp, &src_buf);
+	convert_stream(src_file, sfp, dfp, NULL, NULL);
+
+	start = trace_begin("flush", src_file);
+	ret = fflush(dfp);
+	trace_end("flush", src_file, start);
+
+	start = trace_begin("close", src_file);
+	fclose(sfp);
+	free(src_buf);
+	if(fclose(dfp) != 0 || ret != 0 || rename(tmp_file, dest_file) != 0)
+	{
+		unlink(tmp_file);
+		trace_end("close", src_file, start);
+		return CONV_ERR_DEST;
+	}
+	trace_end("close", src_file, start);
+
+	return CONV_OK;
+}
+
+/* convert source already read into memory, src_file only picks the language */
+int convert_buffer(const char *src_file, const char *buf, size_t len, FILE *dfp,
+		conv_hook_fn hook, void *ctx)
+{
+	FILE *sfp = NULL;
+
+	/* an empty file has nothing to parse */
+	if(len && NULL == (sfp = fmemopen((void *)buf, len, "r")))
+		return CONV_ERR_SOURCE;
+
+	convert_stream(src_file, sfp, dfp, hook, ctx);
+
+	if(sfp)
+		fclose(sfp);
+
+	return CONV_OK;
+}
@@ -5,12 +5,30 @@
 
 #define HTML_OPEN	1
 #define HTML_CLOSE	0
+#define HTML_DIFF	2 /* side by side diff page */
+
+/* convert_file return values */
+#define CONV_OK			0
+#define CONV_ERR_SOURCE	2 /* source file could not be opened */
+#define CONV_ERR_DEST	3 /* output file could not be created */
+
+/* called with every event of a file while it is converted */
+typedef void (*conv_hook_fn)(void *ctx, pevent_t *event);
 
 /********** function prototypes **********/
 
-void html_begin(FILE* dest_fp, int type); /* type => not used, but can be used to add differnet HTML tags */
-void html_end(FILE* dest_fp, int type); /* type => not used, but can be used to add differnet HTML tags */
+void html_begin(FILE* dest_fp, int type); /* type => HTML_OPEN, or HTML_DIFF for a side by side diff page */
+void html_end(FILE* dest_fp, int type); /* type => HTML_CLOSE, or HTML_DIFF for a side by side diff page */
+const char *event_class(const pevent_t *event);
+const char *type_class(pevent_e type, int property);
 void source_to_html(FILE* fp, pevent_t *event);
+void source_to_html_mark(FILE* fp, pevent_t *event, const char *mark);
+size_t token_html_length(pevent_e type, int property, const char *data, int length);
+char *token_to_html(char *dst, pevent_e type, int property, const char *data, int length);
+int convert_file(const char *src_file, const char *dest_file); /* output is replaced atomically */
+int convert_buffer(const char *src_file, const char *buf, size_t len, FILE *dfp,
+		conv_hook_fn hook, void *ctx); /* hook may be NULL */
+void conv_tmp_name(char *tmp_file, size_t size, const char *dest_file);
 
 #endif
 
@@ -0,0 +1,522 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "s2html_event.h"
+#include "s2html_conv.h"
+#include "s2html_lang.h"
+#include "s2html_diff.h"
+
+//structure to hold the state of one diff
+typedef struct
+{
+	diff_file_t *a;     // old file
+	diff_file_t *b;     // new file
+	int lines;          // compare lines instead of tokens
+	char *del;          // del[i] set => a token (or line) i is deleted
+	char *ins;          // ins[j] set => b token (or line) j is inserted
+	int *vf;            // forward furthest reaching x per diagonal
+	int *vb;            // backward furthest reaching x per diagonal
+}diff_ctx_t;
+
+/********** Utility functions **********/
+
+/* FNV-1a hash of the token */
+static unsigned int diff_hash(pevent_t *event)
+{
+	unsigned int h = 2166136261u;
+	int idx;
+
+	h = (h ^ event->type) * 16777619u;
+	h = (h ^ event->property) * 16777619u;
+	for(idx = 0; idx < event->length; idx++)
+		h = (h ^ (unsigned char)event->data[idx]) * 16777619u;
+
+	return h;
+}
+
+/* token ends a line */
+static int diff_ends_line(diff_file_t *file, int idx)
+{
+	diff_token_t *tok = &file->tokens[idx];
+
+	return file->text[tok->offset + tok->length - 1] == '\n';
+}
+
+/* group the tokens of the file into lines */
+static int diff_split_lines(diff_file_t *file)
+{
+	diff_line_t *line;
+	int idx;
+
+	if((file->lines = malloc((file->count + 1) * sizeof(diff_line_t))) == NULL)
+		return -1;
+
+	line = file->lines;
+	line->first = 0;
+	line->hash = 2166136261u;
+	for(idx = 0; idx < file->count; idx++)
+	{
+		line->hash = (line->hash ^ file->tokens[idx].hash) * 16777619u;
+		if(diff_ends_line(file, idx) || idx == file->count - 1)
+		{
+			line->count = idx + 1 - line->first;
+			line++;
+			line->first = idx + 1;
+			line->hash = 2166136261u;
+		}
+	}
+	line->count = 0;
+	file->num_lines = line - file->lines;
+
+	return 0;
+}
+
+/********** diff functions **********/
+
+/* lex the file and keep all its tokens */
+int diff_read_file(const char *file_name, diff_file_t *file)
+{
+	FILE *fp;
+	pevent_t *event;
+	diff_token_t *tok;
+
+	memset(file, 0, sizeof(diff_file_t));
+	if((fp = fopen(file_name, "r")) == NULL)
+		return -1;
+
+	lang_select(file_name);
+	reset_parser();
+
+	do
+	{
+		event = get_parser_event(fp);
+		if(event->length == 0)
+			continue;
+
+		if(file->count == file->size)
+		{
+			file->size = file->size ? file->size * 2 : 1024;
+			if((file->tokens = realloc(file->tokens, file->size * sizeof(diff_token_t))) == NULL)
+				break;
+		}
+		if(file->text_len + event->length + 1 > file->text_size)
+		{
+			file->text_size = file->text_size ? file->text_size * 2 : 16384;
+			while(file->text_len + event->length + 1 > file->text_size)
+				file->text_size *= 2;
+			if((file->text = realloc(file->text, file->text_size)) == NULL)
+				break;
+		}
+
+		tok = &file->tokens[file->count++];
+		tok->type = event->type;
+		tok->property = event->property;
+		tok->length = event->length;
+		tok->offset = file->text_len;
+		tok->hash = diff_hash(event);
+		memcpy(file->text + file->text_len, event->data, event->length + 1);
+		file->text_len += event->length + 1;
+	} while(event->type != PEVENT_EOF);
+
+	fclose(fp);
+
+	if((!file->tokens || !file->text) && file->count)
+		return -1;
+
+	return diff_split_lines(file);
+}
+
+void diff_free_file(diff_file_t *file)
+{
+	free(file->tokens);
+	free(file->text);
+	free(file->lines);
+}
+
+/********** Utility functions **********/
+
+/* compare token i of old file with token j of new file */
+static int diff_token_equal(diff_ctx_t *c, int i, int j)
+{
+	diff_token_t *ta = &c->a->tokens[i];
+	diff_token_t *tb = &c->b->tokens[j];
+
+	return ta->hash == tb->hash && ta->type == tb->type && ta->property == tb->property &&
+		ta->length == tb->length &&
+		memcmp(c->a->text + ta->offset, c->b->text + tb->offset, ta->length) == 0;
+}
+
+/* compare token (or line) i of old file with token (or line) j of new file */
+static int diff_equal(diff_ctx_t *c, int i, int j)
+{
+	diff_line_t *la, *lb;
+	int idx;
+
+	if(!c->lines)
+		return diff_token_equal(c, i, j);
+
+	la = &c->a->lines[i];
+	lb = &c->b->lines[j];
+	if(la->hash != lb->hash || la->count != lb->count)
+		return 0;
+	for(idx = 0; idx < la->count; idx++)
+	{
+		if(!diff_token_equal(c, la->first + idx, lb->first + idx))
+			return 0;
+	}
+
+	return 1;
+}
+
+/* find the middle of the shortest edit script of a[a0, a1) and b[b0, b1)
+ * (Myers, "An O(ND) Difference Algorithm and Its Variations", section 4b)
+ * both ranges are not empty and differ at the first and last token
+ */
+static void diff_middle(diff_ctx_t *c, int a0, int a1, int b0, int b1, int *mx, int *my)
+{
+	int n = a1 - a0, m = b1 - b0;
+	int delta = n - m, odd = delta & 1;
+	int max = (n + m + 1) / 2;
+	int d, k, x, y;
+
+	c->vf[1] = 0;
+	c->vb[1] = 0;
+
+	for(d = 0; d <= max; d++)
+	{
+		/* forward paths from the top left corner */
+		for(k = -d; k <= d; k += 2)
+		{
+			if(k == -d || (k != d && c->vf[k - 1] < c->vf[k + 1]))
+				x = c->vf[k + 1];
+			else
+				x = c->vf[k - 1] + 1;
+			y = x - k;
+			while(x < n && y < m && diff_equal(c, a0 + x, b0 + y))
+			{
+				x++;
+				y++;
+			}
+			c->vf[k] = x;
+
+			if(odd && k >= delta - (d - 1) && k <= delta + (d - 1) && x + c->vb[delta - k] >= n)
+			{
+				*mx = x;
+				*my = y;
+				return;
+			}
+		}
+
+		/* backward paths from the bottom right corner, x counts from the end */
+		for(k = -d; k <= d; k += 2)
+		{
+			if(k == -d || (k != d && c->vb[k - 1] < c->vb[k + 1]))
+				x = c->vb[k + 1];
+			else
+				x = c->vb[k - 1] + 1;
+			y = x - k;
+			while(x < n && y < m && diff_equal(c, a1 - 1 - x, b1 - 1 - y))
+			{
+				x++;
+				y++;
+			}
+			c->vb[k] = x;
+
+			if(!odd && delta - k >= -d && delta - k <= d && x + c->vf[delta - k] >= n)
+			{
+				*mx = n - x;
+				*my = m - y;
+				return;
+			}
+		}
+	}
+
+	/* not reached for valid input, split anywhere */
+	*mx = n / 2;
+	*my = m / 2;
+}
+
+/* mark the deleted and inserted tokens (or lines) of a[a0, a1) against b[b0, b1) */
+static void diff_compare(diff_ctx_t *c, int a0, int a1, int b0, int b1)
+{
+	int x, y;
+
+	/* skip common prefix and suffix */
+	while(a0 < a1 && b0 < b1 && diff_equal(c, a0, b0))
+	{
+		a0++;
+		b0++;
+	}
+	while(a0 < a1 && b0 < b1 && diff_equal(c, a1 - 1, b1 - 1))
+	{
+		a1--;
+		b1--;
+	}
+
+	if(a0 == a1)
+	{
+		memset(c->ins + b0, 1, b1 - b0);
+		return;
+	}
+	if(b0 == b1)
+	{
+		memset(c->del + a0, 1, a1 - a0);
+		return;
+	}
+
+	diff_middle(c, a0, a1, b0, b1, &x, &y);
+	diff_compare(c, a0, a0 + x, b0, b0 + y);
+	diff_compare(c, a0 + x, a1, b0 + y, b1);
+}
+
+/* write one token, marked with css class when mark is not NULL */
+static void diff_write_token(FILE *fp, diff_file_t *file, int idx, const char *mark, pevent_t *event)
+{
+	diff_token_t *tok = &file->tokens[idx];
+	int len = tok->length < PEVENT_DATA_SIZE ? tok->length : PEVENT_DATA_SIZE - 1;
+
+	event->type = tok->type;
+	event->property = tok->property;
+	event->length = len;
+	memcpy(event->data, file->text + tok->offset, len);
+	event->data[len] = '\0';
+
+	source_to_html_mark(fp, event, mark);
+}
+
+/* number of new lines in the token */
+static int diff_lines(diff_file_t *file, int idx)
+{
+	const char *p = file->text + file->tokens[idx].offset;
+	int lines = 0;
+
+	while(*p)
+		lines += (*p++ == '\n');
+
+	return lines;
+}
+
+/* write both files side by side, blank lines keep unchanged lines next to each other */
+static void diff_write(diff_ctx_t *c, FILE *left, FILE *right, int *deleted, int *inserted)
+{
+	pevent_t *event = malloc(sizeof(pevent_t));
+	int i = 0, j = 0;
+	int hunk_l = 0, hunk_r = 0; // new lines in current change on each side
+	int pad_l = 0, pad_r = 0;   // blank lines owed to each side
+	int bol_l = 1, bol_r = 1;   // side is at the begining of a line
+
+	*deleted = *inserted = 0;
+	if(event == NULL)
+		return;
+
+	while(i < c->a->count || j < c->b->count)
+	{
+		if(i < c->a->count && c->del[i])
+		{
+			diff_write_token(left, c->a, i, DIFF_CLASS_DEL, event);
+			hunk_l += diff_lines(c->a, i);
+			bol_l = diff_ends_line(c->a, i);
+			(*deleted)++;
+			i++;
+			continue;
+		}
+		if(j < c->b->count && c->ins[j])
+		{
+			diff_write_token(right, c->b, j, DIFF_CLASS_INS, event);
+			hunk_r += diff_lines(c->b, j);
+			bol_r = diff_ends_line(c->b, j);
+			(*inserted)++;
+			j++;
+			continue;
+		}
+
+		/* change finished, the shorter side owes the difference */
+		if(hunk_l > hunk_r)
+			pad_r += hunk_l - hunk_r;
+		else
+			pad_l += hunk_r - hunk_l;
+		hunk_l = hunk_r = 0;
+
+		/* blank lines go between complete lines only */
+		if(bol_l && bol_r)
+		{
+			for(; pad_l; pad_l--)
+				fputc('\n', left);
+			for(; pad_r; pad_r--)
+				fputc('\n', right);
+		}
+
+		diff_write_token(left, c->a, i, NULL, event);
+		diff_write_token(right, c->b, j, NULL, event);
+		bol_l = bol_r = diff_ends_line(c->a, i);
+		i++;
+		j++;
+	}
+
+	for(; pad_l; pad_l--)
+		fputc('\n', left);
+	for(; pad_r; pad_r--)
+		fputc('\n', right);
+
+	free(event);
+}
+
+/********** diff functions **********/
+
+/* set up the context, the search arrays are big enough for the tokens */
+static int diff_init(diff_ctx_t *c, diff_file_t *a, diff_file_t *b)
+{
+	int diag = a->count + b->count + 2; // diagonals range over -(n + m) .. n + m
+
+	c->a = a;
+	c->b = b;
+	c->vf = malloc((2 * diag + 1) * sizeof(int));
+	c->vb = malloc((2 * diag + 1) * sizeof(int));
+	if(!c->vf || !c->vb)
+	{
+		free(c->vf);
+		free(c->vb);
+		return -1;
+	}
+	c->vf += diag;
+	c->vb += diag;
+
+	return diag;
+}
+
+static void diff_release(diff_ctx_t *c, int diag)
+{
+	free(c->vf - diag);
+	free(c->vb - diag);
+}
+
+int diff_mark_lines(diff_file_t *a, diff_file_t *b, char *del, char *ins)
+{
+	diff_ctx_t c;
+	int diag;
+
+	if((diag = diff_init(&c, a, b)) < 0)
+		return -1;
+
+	c.lines = 1;
+	c.del = del;
+	c.ins = ins;
+	memset(del, 0, a->num_lines);
+	memset(ins, 0, b->num_lines);
+	diff_compare(&c, 0, a->num_lines, 0, b->num_lines);
+
+	diff_release(&c, diag);
+
+	return 0;
+}
+
+int diff_mark(diff_file_t *a, diff_file_t *b, char *del, char *ins)
+{
+	char *line_del = malloc(a->num_lines + 1), *line_ins = malloc(b->num_lines + 1);
+	diff_ctx_t c;
+	int i = 0, j = 0, i1, j1, diag = -1;
+
+	if(line_del && line_ins && diff_mark_lines(a, b, line_del, line_ins) == 0)
+		diag = diff_init(&c, a, b);
+	if(diag < 0)
+	{
+		free(line_del);
+		free(line_ins);
+		return -1;
+	}
+
+	c.lines = 0;
+	c.del = del;
+	c.ins = ins;
+	memset(del, 0, a->count);
+	memset(ins, 0, b->count);
+
+	/* tokens of each block of changed lines against each other */
+	while(i < a->num_lines || j < b->num_lines)
+	{
+		if(i < a->num_lines && j < b->num_lines && !line_del[i] && !line_ins[j])
+		{
+			i++;
+			j++;
+			continue;
+		}
+		for(i1 = i; i1 < a->num_lines && line_del[i1]; i1++)
+			;
+		for(j1 = j; j1 < b->num_lines && line_ins[j1]; j1++)
+			;
+		diff_compare(&c, a->lines[i].first, a->lines[i1].first, b->lines[j].first, b->lines[j1].first);
+		i = i1;
+		j = j1;
+	}
+
+	diff_release(&c, diag);
+	free(line_del);
+	free(line_ins);
+
+	return 0;
+}
+
+int diff_files(const char *old_file, const char *new_file, const char *dest_file)
+{
+	diff_file_t a, b;
+	diff_ctx_t c;
+	FILE *dfp, *right;
+	char *right_buf = NULL;
+	size_t right_len = 0;
+	int deleted, inserted;
+
+	if(diff_read_file(old_file, &a) < 0)
+	{
+		printf("Error! File %s could not be opened\n", old_file);
+		diff_free_file(&a);
+		return 2;
+	}
+	if(diff_read_file(new_file, &b) < 0)
+	{
+		printf("Error! File %s could not be opened\n", new_file);
+		diff_free_file(&a);
+		diff_free_file(&b);
+		return 2;
+	}
+
+	c.a = &a;
+	c.b = &b;
+	c.del = calloc(a.count + 1, 1);
+	c.ins = calloc(b.count + 1, 1);
+	dfp = fopen(dest_file, "w");
+	right = open_memstream(&right_buf, &right_len);
+
+	if(!c.del || !c.ins || !dfp || !right || diff_mark(&a, &b, c.del, c.ins) < 0)
+	{
+		printf("Error! could not create %s output file\n", dest_file);
+		if(dfp)
+			fclose(dfp);
+		if(right)
+			fclose(right);
+		free(right_buf);
+		free(c.del);
+		free(c.ins);
+		diff_free_file(&a);
+		diff_free_file(&b);
+		return 3;
+	}
+	lang_select(new_file);
+	html_begin(dfp, HTML_DIFF);
+	diff_write(&c, dfp, right, &deleted, &inserted);
+	fclose(right);
+	fprintf(dfp, "</pre>\n</td><td>\n<pre>\n");
+	fwrite(right_buf, 1, right_len, dfp);
+	html_end(dfp, HTML_DIFF);
+	fclose(dfp);
+
+	printf("\nDiff file %s generated: %d tokens deleted, %d tokens inserted\n", dest_file, deleted, inserted);
+
+	free(right_buf);
+	free(c.del);
+	free(c.ins);
+	diff_free_file(&a);
+	diff_free_file(&b);
+
+	return 0;
+}
+/**** End of file ****/
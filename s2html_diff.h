@@ -0,0 +1,59 @@
+#ifndef S2HTML_DIFF_H
+#define S2HTML_DIFF_H
+
+/* css classes added to changed tokens, see styles.css */
+#define DIFF_CLASS_DEL	"diff_del"
+#define DIFF_CLASS_INS	"diff_ins"
+
+//structure to hold one token of a lexed file
+typedef struct
+{
+	pevent_e type;      // event type
+	int property;       // property associated with data
+	int length;         // data length
+	long offset;        // data offset in the text arena
+	unsigned int hash;  // hash of type, property and data
+}diff_token_t;
+
+//structure to hold one line of a lexed file, the tokens up to a new line
+typedef struct
+{
+	int first;          // index of the first token
+	int count;          // number of tokens
+	unsigned int hash;  // hash of the hashes of the tokens
+}diff_line_t;
+
+//structure to hold the tokens of one file
+typedef struct
+{
+	diff_token_t *tokens;
+	int count;
+	int size;
+	diff_line_t *lines; // num_lines + 1 entries, the last one starts at count
+	int num_lines;
+	char *text;         // data of all tokens, '\0' separated
+	long text_len;
+	long text_size;
+}diff_file_t;
+
+/********** function prototypes **********/
+
+int diff_read_file(const char *file_name, diff_file_t *file); /* lex the file, -1 on error */
+void diff_free_file(diff_file_t *file);
+
+/* shortest edit script of the lines: del[i] is set for deleted lines of a,
+ * ins[j] for inserted lines of b, returns -1 when out of memory
+ */
+int diff_mark_lines(diff_file_t *a, diff_file_t *b, char *del, char *ins);
+
+/* changed tokens: the lines are compared first, then the tokens of each
+ * changed block of lines. del[i] is set for deleted tokens of a, ins[j]
+ * for inserted tokens of b, returns -1 when out of memory
+ */
+int diff_mark(diff_file_t *a, diff_file_t *b, char *del, char *ins);
+
+/* write a side by side html page of the changes from old_file to new_file */
+int diff_files(const char *old_file, const char *new_file, const char *dest_file);
+
+#endif
+/**** End of file ****/
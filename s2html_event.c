@@ -3,10 +3,10 @@
 #include <string.h>
 #include <ctype.h>
 #include "s2html_event.h"
+#include "s2html_lang.h"
 
-#define SIZE_OF_SYMBOLS (sizeof(symbols))
-#define SIZE_OF_OPERATORS (sizeof(operators))
 #define WORD_BUFF_SIZE	100
+#define EVENT_SPLIT_SIZE	(PEVENT_DATA_SIZE - 16) /* longer tokens are given in pieces */
 
 /********** Internal states and event of parser **********/
 typedef enum
@@ -25,35 +25,26 @@ typedef enum
 	PSTATE_ASCII_CHAR
 }pstate_e;
 
-/********** global variables **********/
+/********** global variables **********
+ * parser state is kept per thread so that several files
+ * can be parsed at the same time by different threads
+ ****************************************/
 
 /* parser state variable */
-static pstate_e state = PSTATE_IDLE;
+static __thread pstate_e state = PSTATE_IDLE;
 
 /* sub state is used only in preprocessor state */
-static pstate_e state_sub = PSTATE_SUB_PREPROCESSOR_MAIN;
+static __thread pstate_e state_sub = PSTATE_SUB_PREPROCESSOR_MAIN;
 
 /* event variable to store event and related properties */
-static pevent_t pevent_data;  //structure to store the data
-static int event_data_idx = 0;  //indexing variable
-
-static char word[WORD_BUFF_SIZE];   //buffer to store words
-static int word_idx = 0;          //indexing variable
-
-
-static char* res_kwords_data[] = {"const", "volatile", "extern", "auto", "register",
-   						   "static", "signed", "unsigned", "short", "long", 
-						   "double", "char", "int", "float", "struct", 
-						   "union", "enum", "void", "typedef", ""
-						  };
+static __thread pevent_t pevent_data;  //structure to store the data
+static __thread int event_data_idx = 0;  //indexing variable
+static __thread char *event_buf;  //where the data of the event is collected
 
-static char* res_kwords_non_data[] = {"goto", "return", "continue", "break", 
-							   "if", "else", "for", "while", "do", 
-							   "switch", "case", "default","sizeof", ""
-							  };
-
-static char operators[] = {'/', '+', '*', '-', '%', '=', '<', '>', '~', '&', ',', '!', '^', '|'};
-static char symbols[] = {'(', ')', '{', '[', ':'};
+static __thread char word[WORD_BUFF_SIZE];   //buffer to store words
+static __thread int string_quote = '"';    //character that ends the current string
+static __thread int header_split = 0;      //a long standard header goes on as plain header pieces
+static __thread int word_idx = 0;          //indexing variable
 
 /********** state handlers **********/
 pevent_t * pstate_idle_handler(FILE *fd, int ch);
@@ -72,57 +63,75 @@ pevent_t * pstate_sub_preprocessor_main_handler(FILE *fd, int ch);
 /* function to check if given word is reserved key word */
 static int is_reserved_keyword(char *word)
 {
-	int idx = 0;
-
-	/* search for data type reserved keyword */
-	while(*res_kwords_data[idx])
-	{
-		if(strcmp(res_kwords_data[idx++], word) == 0)
-			return RES_KEYWORD_DATA;
-	}
+	return lang_keyword(lang_current(), word);
+}
 
-	idx = 0; // reset index
+/* function to check symbols */
+static int is_symbol(char c)
+{
+	return lang_current()->char_class[(unsigned char)c] & CCLASS_SYMBOL;
+}
 
-	/* search for non data type reserved key word */
-	while(*res_kwords_non_data[idx])
-	{
-		if(strcmp(res_kwords_non_data[idx++], word) == 0)
-			return RES_KEYWORD_NON_DATA;
-	}
+/* function to check operator */
+static int is_operator(char c)
+{
+	return lang_current()->char_class[(unsigned char)c] & CCLASS_OPERATOR;
+}
 
-	return 0; // word did not match, return false
+/* add a character to the event data, the data never outgrows PEVENT_DATA_SIZE */
+static inline void event_put(int ch)
+{
+	if(event_data_idx < PEVENT_DATA_SIZE - 1)
+		event_buf[event_data_idx++] = ch;
 }
 
-/* function to check symbols */
-static int is_symbol(char c)
+/* collect the base and digits of a sized literal like 8'hFF after the quote */
+static void read_based_literal(FILE *fd)
 {
-	int idx;
-	for(idx = 0; idx < SIZE_OF_SYMBOLS; idx++)
+	int ch;
+
+	while(event_data_idx < EVENT_SPLIT_SIZE && (ch = getc_unlocked(fd)) != EOF)
 	{
-		if(symbols[idx] == c)
-			return 1;
+		if(!isalnum(ch) && ch != '_' && ch != '?')
+		{
+			fseek(fd, -1L, SEEK_CUR); // unget the char after the literal
+			break;
+		}
+		event_put(ch);
 	}
-
-	return 0;
 }
 
-/* function to check operator */
-static int is_operator(char c)
+/* collect a shell variable after its $: ${...} up to the brace,
+ * or a special one like $# or $?
+ */
+static void read_dollar_var(FILE *fd)
 {
-	int idx;
-	for(idx = 0; idx < SIZE_OF_OPERATORS; idx++)
+	int ch = getc_unlocked(fd);
+
+	if(ch == '{')
 	{
-		if(operators[idx] == c)
-			return 1;
+		event_put(ch);
+		while(event_data_idx < EVENT_SPLIT_SIZE && (ch = getc_unlocked(fd)) != EOF && ch != '\n')
+		{
+			event_put(ch);
+			if(ch == '}')
+				return;
+		}
+	}
+	else if(ch != EOF && strchr("#?@*$!-0123456789", ch))
+	{
+		event_put(ch);
+		return;
 	}
 
-	return 0;
+	if(ch != EOF)
+		fseek(fd, -1L, SEEK_CUR); // unget the char after the $
 }
 
 /* to set parser event */
 static void set_parser_event(pstate_e s, pevent_e e)
 {
-	pevent_data.data[event_data_idx] = '\0';
+	event_buf[event_data_idx] = '\0';
 	pevent_data.length = event_data_idx;
 	event_data_idx = 0;
 	state = s;
@@ -130,23 +139,84 @@ static void set_parser_event(pstate_e s, pevent_e e)
     
 }
 
+/* give the data collected so far as an event of the current token,
+ * the state is kept and the token goes on in the next event
+ */
+static pevent_t *split_parser_event(void)
+{
+	static const pevent_e split_events[] = {
+		[PSTATE_IDLE] = PEVENT_REGULAR_EXP,
+		[PSTATE_PREPROCESSOR_DIRECTIVE] = PEVENT_PREPROCESSOR_DIRECTIVE,
+		[PSTATE_HEADER_FILE] = PEVENT_HEADER_FILE,
+		[PSTATE_RESERVE_KEYWORD] = PEVENT_REGULAR_EXP,
+		[PSTATE_NUMERIC_CONSTANT] = PEVENT_NUMERIC_CONSTANT,
+		[PSTATE_STRING] = PEVENT_STRING,
+		[PSTATE_SINGLE_LINE_COMMENT] = PEVENT_SINGLE_LINE_COMMENT,
+		[PSTATE_MULTI_LINE_COMMENT] = PEVENT_MULTI_LINE_COMMENT,
+		[PSTATE_ASCII_CHAR] = PEVENT_ASCII_CHAR,
+	};
+
+	/* the brackets of a standard header are added when it is rendered, the
+	 * pieces of a split one carry them in their data instead
+	 */
+	if(state == PSTATE_HEADER_FILE && pevent_data.property == STD_HEADER_FILE)
+	{
+		memmove(event_buf + 1, event_buf, event_data_idx++);
+		event_buf[0] = '<';
+		pevent_data.property = USER_HEADER_FILE;
+		header_split = 1;
+	}
+
+	event_buf[event_data_idx] = '\0';
+	pevent_data.length = event_data_idx;
+	event_data_idx = 0;
+	pevent_data.type = split_events[state];
+
+	return &pevent_data;
+}
+
 
 /************ Event functions **********/
 
+/* bring the parser back to idle state before parsing a new file */
+void reset_parser(void)
+{
+	state = PSTATE_IDLE;
+	state_sub = PSTATE_SUB_PREPROCESSOR_MAIN;
+	event_data_idx = 0;
+	pevent_data.property = 0;
+	string_quote = '"';
+	header_split = 0;
+}
+
+/* the next event starts fresh at the stream position */
+int parser_is_idle(void)
+{
+	return state == PSTATE_IDLE && state_sub == PSTATE_SUB_PREPROCESSOR_MAIN && event_data_idx == 0;
+}
+
 /* This function parses the source file and generate 
- * event based on parsed characters and string
+ * event based on parsed characters and string,
+ * the stream is locked by the caller
  */
-pevent_t *get_parser_event(FILE *fd)
+static pevent_t *parse_event(FILE *fd)
 {
 	int ch, pre_ch;    //variable to store the present and previous character
 	pevent_t *evptr = NULL;       //structure pointer
 
 	/* Read char by char */
-	while((ch = fgetc(fd)) != EOF)
+	while((ch = getc_unlocked(fd)) != EOF)
 	{
 #ifdef DEBUG
 	//	putchar(ch);
 #endif
+		//a handler adds at most two chars, a long token is split before the data is full
+		if(event_data_idx >= EVENT_SPLIT_SIZE)
+		{
+			fseek(fd, -1L, SEEK_CUR); // unget the char, it starts the next piece
+			return split_parser_event();
+		}
+
         //to check the types of event obtained
 		switch(state)
 		{
@@ -208,6 +278,70 @@ pevent_t *get_parser_event(FILE *fd)
 	return &pevent_data; // return final event
 }
 
+/* to get the next event of the file */
+pevent_t *get_parser_event(FILE *fd)
+{
+	pevent_t *evptr;   //structure pointer
+
+	flockfile(fd);
+	event_buf = pevent_data.data;
+	evptr = parse_event(fd);
+	funlockfile(fd);
+
+	return evptr;
+}
+
+/* This function parses up to batch->size events into the arrays of the
+ * batch, the data of each event is collected straight into the batch text.
+ * It stops early when the text buffer could not hold one more event and
+ * after the EOF event. Returns the number of events.
+ */
+int get_parser_events(FILE *fd, pevent_batch_t *batch)
+{
+	pevent_t *evptr;   //structure pointer
+	int count = 0;
+	long text_len = 0;
+
+	flockfile(fd);
+	while(count < batch->size && text_len + PEVENT_DATA_SIZE <= batch->text_size)
+	{
+		event_buf = batch->text + text_len;
+		evptr = parse_event(fd);
+
+		batch->types[count] = evptr->type;
+		batch->properties[count] = evptr->property;
+		batch->offsets[count] = text_len;
+		batch->lengths[count] = evptr->length;
+		text_len += evptr->length;
+		count++;
+
+		if(evptr->type == PEVENT_EOF)
+			break;
+	}
+	event_buf = pevent_data.data;
+	funlockfile(fd);
+
+	batch->count = count;
+	batch->text_len = text_len;
+
+	return count;
+}
+
+/* to handle common text in idle state */
+static pevent_t * pstate_idle_regular_char(int ch)
+{
+    //if the character is a symbol,operator,whitespace,newline or tab makeing it as regular expression and printing into the html file
+    if( (is_symbol(ch)) || (is_operator(ch)) || (ch == '\n') || (ch == ' ') || (ch == '\t'))
+    {
+        event_put(ch);  //add the character to array
+        set_parser_event(PSTATE_IDLE, PEVENT_REGULAR_EXP);  //call the set parser function as event regular expression
+        return &pevent_data;   //returning the structure holding info
+    }
+
+    //else add to the character to the array
+    event_put(ch);
+    return NULL;
+}
 
 /********** IDLE state Handler **********
  * Idle state handler identifies
@@ -215,18 +349,80 @@ pevent_t *get_parser_event(FILE *fd)
 pevent_t * pstate_idle_handler(FILE *fd, int ch)
 {
 	int pre_ch;   //variable to hold the previous character
+	const lang_t *lang = lang_current();  //language of the file being parsed
+
+	//to detect preprocessor directive and macros
+	if(lang->directive_char && ch == lang->directive_char)
+	{
+		if(event_data_idx) // we have regular exp in buffer first process that
+		{
+			fseek(fd, -1L, SEEK_CUR); // unget chars
+			set_parser_event(PSTATE_IDLE, PEVENT_REGULAR_EXP);
+			return &pevent_data;
+		}
+		state = PSTATE_PREPROCESSOR_DIRECTIVE;  //change the state top preprocessor directive
+		event_put(ch);  //add # to the array
+		return NULL;
+	}
+
+	//to detect single line comments of languages like shell, a # inside a word is text
+	if(lang->line_comment_char && ch == lang->line_comment_char)
+	{
+		if(event_data_idx)
+			return pstate_idle_regular_char(ch);
+		state = PSTATE_SINGLE_LINE_COMMENT;   //change the state to single line comment
+		event_put(ch);
+		return NULL;
+	}
+
+	//variables like $# or ${#arr[@]} are text, not comments
+	if(ch == '$' && (lang->flags & LANG_DOLLAR_VARS))
+	{
+		event_put(ch);
+		read_dollar_var(fd);
+		return NULL;
+	}
+
+	//'/' is a plain operator for languages without C comments
+	if(ch == '/' && !(lang->flags & LANG_C_COMMENTS))
+		return pstate_idle_regular_char(ch);
+
+	//a quote starts a based literal like 'hFF in languages with sized literals
+	if(ch == '\'' && (lang->flags & LANG_SIZED_LITERALS))
+	{
+		if(event_data_idx) // we have regular exp in buffer first process that
+		{
+			fseek(fd, -1L, SEEK_CUR); // unget chars
+			set_parser_event(PSTATE_IDLE, PEVENT_REGULAR_EXP);
+			return &pevent_data;
+		}
+		event_put(ch);
+		read_based_literal(fd);
+		//a quote without base and digits, like the one of '{...}, is plain text
+		set_parser_event(PSTATE_IDLE, event_data_idx > 1 ? PEVENT_NUMERIC_CONSTANT : PEVENT_REGULAR_EXP);
+		return &pevent_data;
+	}
+
+	//single quoted strings of languages like shell
+	if(ch == '\'' && (lang->flags & LANG_SINGLE_QUOTES))
+	{
+		state = PSTATE_STRING;
+		string_quote = ch;
+		event_put(ch);
+		return NULL;
+	}
 
     //to check for the type of character obtained
 	switch(ch)
 	{
 		case '\'' : // begining of ASCII char 
             state = PSTATE_ASCII_CHAR;   //change the state as ASCII char
-            pevent_data.data[event_data_idx++] = ch;  //add the ascii char to the array
+            event_put(ch);  //add the ascii char to the array
 			break;
 
 		case '/' :
 			pre_ch = ch;
-			if((ch = fgetc(fd)) == '*') // multi line comment
+			if((ch = getc_unlocked(fd)) == '*') // multi line comment
 			{
 				if(event_data_idx) // we have regular exp in buffer first process that
 				{
@@ -241,8 +437,8 @@ pevent_t * pstate_idle_handler(FILE *fd, int ch)
 #endif
 					state = PSTATE_MULTI_LINE_COMMENT;    //change the state as multi line comment
                     //add characters to the array
-					pevent_data.data[event_data_idx++] = pre_ch;   
-					pevent_data.data[event_data_idx++] = ch;
+					event_put(pre_ch);   
+					event_put(ch);
 				}
 			}
 			else if(ch == '/') // single line comment
@@ -260,62 +456,37 @@ pevent_t * pstate_idle_handler(FILE *fd, int ch)
 #endif
 					state = PSTATE_SINGLE_LINE_COMMENT;   //change the state to single line comment
                     // add // to the array
-					pevent_data.data[event_data_idx++] = pre_ch;
-					pevent_data.data[event_data_idx++] = ch;
+					event_put(pre_ch);
+					event_put(ch);
 				}
 			}
 			else // it is regular exp
 			{
-				pevent_data.data[event_data_idx++] = pre_ch;
-				pevent_data.data[event_data_idx++] = ch;
+				event_put(pre_ch);
+				event_put(ch);
 			}
 			break;
 
-		case '#' : //to detect preprocessor directive and macros
-                if(event_data_idx) // we have regular exp in buffer first process that
-                 {
-                     fseek(fd, -1L, SEEK_CUR); // unget chars
-                     set_parser_event(PSTATE_IDLE, PEVENT_REGULAR_EXP);
-                     return &pevent_data;
-                 }
-                else
-                {
-                    state = PSTATE_PREPROCESSOR_DIRECTIVE;  //change the state top preprocessor directive
-                    pevent_data.data[event_data_idx++] = ch;  //add # to the array
-                }
-			break;
-
 		case '\"' : //to detect strings
                
             state = PSTATE_STRING;  //change the state to string
-            pevent_data.data[event_data_idx++] = ch;
+            string_quote = ch;
+            event_put(ch);
 			break;
                
 
 		case '0' ... '9' : // detect numeric constant            
              state = PSTATE_NUMERIC_CONSTANT;  //change the state as numeric conatant
-		     pevent_data.data[event_data_idx++] = ch;	
+		     event_put(ch);	
 			 break;
                 
 		case 'a' ... 'z' : // could be reserved key word                               
              state = PSTATE_RESERVE_KEYWORD;    //change the state as reserved keyword
-		     pevent_data.data[event_data_idx++] = ch;
+		     event_put(ch);
 			 break;
                 
 		default : // Assuming common text starts by default.
-            //if the character is a symbol,operator,whitespace,newline or tab makeing it as regular expression and printing into the html file
-            if( (is_symbol(ch)) || (is_operator(ch)) || (ch == '\n') || (ch == ' ') || (ch == '\t'))     
-            {
-                pevent_data.data[event_data_idx++] = ch;  //add the character to array
-                set_parser_event(PSTATE_IDLE, PEVENT_REGULAR_EXP);  //call the set parser function as event regular expression
-                return &pevent_data;   //returning the structure holding info
-            }
-            //else add to the character to the array 
-            else
-            {
-			    pevent_data.data[event_data_idx++] = ch;
-			    break;
-            }
+			return pstate_idle_regular_char(ch);
 	}
 
 	return NULL;
@@ -361,17 +532,17 @@ pevent_t * pstate_sub_preprocessor_main_handler(FILE *fd, int ch)
 	    case '<': // Begin of standard header file
 		    state = PSTATE_HEADER_FILE;   //change the state to header file
             pevent_data.property = STD_HEADER_FILE;  //change the sub state as std header file
-		    //pevent_data.data[event_data_idx++] = ' ';
+		    //event_buf[event_data_idx++] = ' ';
 		    break;
 
         case '"' :  //begin of user header file
             state = PSTATE_HEADER_FILE;    //change the state to header file
             pevent_data.property = USER_HEADER_FILE;  //change the sub state as user header file
-            pevent_data.data[event_data_idx++] = ch;   // add the character to array
+            event_put(ch);   // add the character to array
             break;
 
 	    default :   //if the type is not of header file collect the next character and checking for keywords by setting state sub as RESERVE_KEYWORD
-		    pevent_data.data[event_data_idx++] = ch;   
+		    event_put(ch);   
             state_sub = PSTATE_SUB_PREPROCESSOR_RESERVE_KEYWORD;
             break;
     }
@@ -386,21 +557,32 @@ pevent_t * pstate_header_file_handler(FILE *fd, int ch)
 	 * return event data at the end of event
 	 * else return NULL
 	 */
+   // a split standard header ends at its bracket only, which it keeps
+   if(header_split)
+   {
+	event_put(ch);
+	if(ch != '>')
+		return NULL;
+	header_split = 0;
+	set_parser_event(PSTATE_IDLE, PEVENT_HEADER_FILE);
+	return &pevent_data;
+   }
+
    // to check for the ending character 
    switch (ch)
 	{
 	case '>': // End of standard header file
-		//pevent_data.data[event_data_idx++] = ' ';
+		//event_buf[event_data_idx++] = ' ';
 		set_parser_event(PSTATE_IDLE, PEVENT_HEADER_FILE);  //call the set parser event function and add the obtained statements to a structure
 		return &pevent_data;  //returning the structure address
 
     case '"' :  // end of user header file
-        pevent_data.data[event_data_idx++] = ch;  // add the character to array
+        event_put(ch);  // add the character to array
         set_parser_event(PSTATE_IDLE, PEVENT_HEADER_FILE); //call the set parser event function and add the obtained statements to     a structure
         return &pevent_data;  //returning the structure address
 
 	default: // to collect the Characters within the header file
-		pevent_data.data[event_data_idx++] = ch;
+		event_put(ch);
 		break;
 	}
 
@@ -424,20 +606,20 @@ pevent_t * pstate_reserve_keyword_handler(FILE *fd, int ch)
             case '\t':                         // Tab after the word
             case '\n':                         // Newline after the word
                 
-                pevent_data.data[event_data_idx++] = ch; //add the obtained char to the array
+                event_put(ch); //add the obtained char to the array
 
                 //to check the next chars after the word and set the appropriate state
-                while((ch = fgetc(fd) ))
+                while((ch = getc_unlocked(fd) ))
                 {
-                    if(ch == ' ')   //to skip the whitespaces
+                    if(ch == ' ' && event_data_idx < EVENT_SPLIT_SIZE)   //to skip the whitespaces
                     {
-                        pevent_data.data[event_data_idx++] = ch;
+                        event_put(ch);
                         continue;
                     }
                     else if(ch == '<' || ch == '"')  //to check if it is a header or not
                     {
                         fseek(fd, -1L ,SEEK_CUR);  //to put back the char to the stream
-                        pevent_data.data[event_data_idx] = '\0';   // Null terminate the word
+                        event_buf[event_data_idx] = '\0';   // Null terminate the word
                         
                         //to call parser event function by making the state as preprocessor directive    
                         set_parser_event( PSTATE_PREPROCESSOR_DIRECTIVE, PEVENT_PREPROCESSOR_DIRECTIVE);
@@ -458,7 +640,7 @@ pevent_t * pstate_reserve_keyword_handler(FILE *fd, int ch)
                     return &pevent_data;  //retirn the structure address
                  
             default: // Collect characters of the preprocessor
-                pevent_data.data[event_data_idx++] = ch;
+                event_put(ch);
                 break;
         }
 
@@ -471,10 +653,10 @@ pevent_t * pstate_reserve_keyword_handler(FILE *fd, int ch)
         //if the word ends with symbols or operators then check the word 
         if(is_symbol(ch) || is_operator(ch))
         {
-             pevent_data.data[event_data_idx] = '\0';   // Null terminate the word that was read before
+             event_buf[event_data_idx] = '\0';   // Null terminate the word that was read before
       
              //check if the word is keyword or not
-             keyword_type = is_reserved_keyword(pevent_data.data);
+             keyword_type = is_reserved_keyword(event_buf);
  
                  if(keyword_type) // Check if the word is reserved
                  {
@@ -500,33 +682,33 @@ pevent_t * pstate_reserve_keyword_handler(FILE *fd, int ch)
 	            case '\t':							 // Tab after word
 	            case '\n':							 // Newline after word 
                 case ';':                           //end of statement after word    
-                    pevent_data.data[event_data_idx] = '\0';   // Null terminate the word
+                    event_buf[event_data_idx] = '\0';   // Null terminate the word
 		
-                    //printf("checking-%s\n",pevent_data.data);
+                    //printf("checking-%s\n",event_buf);
 
                     //check if the word is keyword or not
-                    keyword_type = is_reserved_keyword(pevent_data.data);
+                    keyword_type = is_reserved_keyword(event_buf);
 
                     if(keyword_type) // Check if the word is reserved
 		            {
                         //call the set function by makinf the evant as reserved keyword
 			            set_parser_event(PSTATE_IDLE, PEVENT_RESERVE_KEYWORD);
                         pevent_data.property = keyword_type;   //set the property of the keyword
-                        //printf("%s is a keyword\n",pevent_data.data);
+                        //printf("%s is a keyword\n",event_buf);
                    
 		            }
 		            else // Regular expression, not reserved
 		            {
                         //call the set function by making the event as regular expression
 			            set_parser_event(PSTATE_IDLE, PEVENT_REGULAR_EXP);
-                        // printf("%s is a  reg_exp\n",pevent_data.data);
+                        // printf("%s is a  reg_exp\n",event_buf);
 		            }
 		
                     fseek(fd, -1, SEEK_CUR); // Unget the last character
 		            return &pevent_data;   //return the structure address
 
 	            default: // Collect characters of the reserved keyword
-		            pevent_data.data[event_data_idx++] = ch;
+		            event_put(ch);
 		            break;
 	        }
         }
@@ -546,7 +728,17 @@ pevent_t * pstate_numeric_constant_handler(FILE *fd, int ch)
 
     if (isdigit(ch)) // Check if character is a digit
 	{
-		pevent_data.data[event_data_idx++] = ch;
+		event_put(ch);
+	}
+	else if((lang_current()->flags & LANG_SIZED_LITERALS) && (ch == '_' || ch == '\''))
+	{
+		event_put(ch);
+		if(ch == '\'') // size given, base and digits follow
+		{
+			read_based_literal(fd);
+			set_parser_event(PSTATE_IDLE, PEVENT_NUMERIC_CONSTANT);
+			return &pevent_data;
+		}
 	}
 	else // End of numeric constant
 	{
@@ -567,24 +759,32 @@ pevent_t * pstate_string_handler(FILE *fd, int ch)
 	 * else return NULL
 	 */
     
+    //single quoted strings have no escapes
+    if(ch == string_quote)
+    {
+        event_put(ch); // adding the char to array
+        set_parser_event(PSTATE_IDLE, PEVENT_STRING);  //calling thge set function by making event as string
+        return &pevent_data;
+    }
+
     switch (ch)
 	    {
-	    case '\"': // End of string
-		    pevent_data.data[event_data_idx++] = ch; // adding the char to array
-		    set_parser_event(PSTATE_IDLE, PEVENT_STRING);  //calling thge set function by making event as string
-		    return &pevent_data;
-
 	    case '\\': // Escape character in string
-		    pevent_data.data[event_data_idx++] = ch;
-		    ch = fgetc(fd);
+		    if(string_quote != '"')
+		    {
+			    event_put(ch);
+			    break;
+		    }
+		    event_put(ch);
+		    ch = getc_unlocked(fd);
 		    if(ch != EOF) // Read the escaped character
 		    {
-			    pevent_data.data[event_data_idx++] = ch;
+			    event_put(ch);
 		    }
 		    break;
 
 	    default: // Regular string character
-		    pevent_data.data[event_data_idx++] = ch;
+		    event_put(ch);
 		    break;
 	}
 
@@ -602,11 +802,11 @@ pevent_t * pstate_single_line_comment_handler(FILE *fd, int ch)
 			printf("\nSingle line comment end\n");
 #endif
 			pre_ch = ch;
-			pevent_data.data[event_data_idx++] = ch;
+			event_put(ch);
 			set_parser_event(PSTATE_IDLE, PEVENT_SINGLE_LINE_COMMENT);
 			return &pevent_data;
 		default :  // collect single line comment chars
-			pevent_data.data[event_data_idx++] = ch;
+			event_put(ch);
 			break;
 	}
 
@@ -621,29 +821,29 @@ pevent_t * pstate_multi_line_comment_handler(FILE *fd, int ch)
 	{
 		case '*' : /* comment might end here */
 			pre_ch = ch;
-			pevent_data.data[event_data_idx++] = ch;
-			if((ch = fgetc(fd)) == '/')
+			event_put(ch);
+			if((ch = getc_unlocked(fd)) == '/')
 			{
 #ifdef DEBUG	
 				printf("\nMulti line comment End : */\n");
 #endif
 				pre_ch = ch;
-				pevent_data.data[event_data_idx++] = ch;
+				event_put(ch);
 				set_parser_event(PSTATE_IDLE, PEVENT_MULTI_LINE_COMMENT);
 				return &pevent_data;
 			}
 			else // multi line comment string still continued
 			{
-				pevent_data.data[event_data_idx++] = ch;
+				event_put(ch);
 			}
 			break;
 		case '/' :
 			/* go back by two steps and read previous char */
 			fseek(fd, -2L, SEEK_CUR); // move two steps back
-			pre_ch = fgetc(fd); // read a char
-			fgetc(fd); // to come back to current offset
+			pre_ch = getc_unlocked(fd); // read a char
+			getc_unlocked(fd); // to come back to current offset
 
-			pevent_data.data[event_data_idx++] = ch;
+			event_put(ch);
 			if(pre_ch == '*')
 			{
 				set_parser_event(PSTATE_IDLE, PEVENT_MULTI_LINE_COMMENT);
@@ -651,7 +851,7 @@ pevent_t * pstate_multi_line_comment_handler(FILE *fd, int ch)
 			}
 			break;
 		default :  // collect multi-line comment chars
-			pevent_data.data[event_data_idx++] = ch;
+			event_put(ch);
 			break;
 	}
 
@@ -670,13 +870,13 @@ pevent_t * pstate_ascii_char_handler(FILE *fd, int ch)
 
         case '\'' :  //end od ACSII character
         case ' ' :
-            pevent_data.data[event_data_idx++] = ch;
+            event_put(ch);
             set_parser_event(PSTATE_IDLE, PEVENT_ASCII_CHAR);
             return &pevent_data;
             break;
 
         default :  //collect the character 
-            pevent_data.data[event_data_idx++] = ch;
+            event_put(ch);
             break;
     }
 
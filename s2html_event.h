@@ -7,7 +7,7 @@
 #define RES_KEYWORD_DATA		3
 #define RES_KEYWORD_NON_DATA	4
 
-#define PEVENT_DATA_SIZE	1024
+#define PEVENT_DATA_SIZE	1024 /* longer tokens are given as several events of the same type */
 
 //used to give values to the events
 typedef enum
@@ -34,9 +34,26 @@ typedef struct
 	char data[PEVENT_DATA_SIZE]; // cwparsed string
 }pevent_t;
 
+//structure to hold a batch of events in caller provided arrays
+typedef struct
+{
+	pevent_e *types;    // event types
+	int *properties;    // event properties
+	long *offsets;      // event data offsets in text
+	int *lengths;       // event data lengths
+	int size;           // entries of the arrays
+	char *text;         // data of all events, not '\0' terminated
+	long text_size;     // at least PEVENT_DATA_SIZE bytes
+	int count;          // events in the batch
+	long text_len;      // bytes used in text
+}pevent_batch_t;
+
 /********** function prototypes **********/
 
 pevent_t *get_parser_event(FILE *fp);
+int get_parser_events(FILE *fp, pevent_batch_t *batch); /* fills the batch, the last batch ends with PEVENT_EOF */
+void reset_parser(void);
+int parser_is_idle(void); /* no event is half parsed */
 
 #endif
 /**** End of file ****/
@@ -0,0 +1,912 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "s2html_event.h"
+#include "s2html_index.h"
+
+#define TYPE_BIT(t)	(1u << (t))
+
+//structure to hold the posting list of one trigram while building
+typedef struct
+{
+	uint32_t key;           // trigram + 1, 0 => empty slot
+	uint32_t count;         // postings in buf
+	uint32_t last_file;     // file of the last posting
+	uint32_t last_pos;      // position of the last posting
+	unsigned char *buf;     // encoded postings
+	size_t len;
+	size_t cap;
+}index_list_t;
+
+struct index_builder
+{
+	index_list_t *lists;    // open addressing table of posting lists
+	size_t lists_size;      // slots, power of two
+	size_t lists_used;
+
+	index_file_t *files;    // name_off is the index into names while building
+	char **names;
+	uint32_t num_files;
+	uint32_t files_size;
+
+	uint32_t *lines;        // line starts of all files
+	size_t lines_len;
+	size_t lines_size;
+
+	/* state of the current file */
+	uint32_t pos;           // offset of next byte
+	unsigned char win[2];   // last two bytes
+	unsigned char win_type[2];
+	int win_len;
+};
+
+//structure to hold one decoded posting
+typedef struct
+{
+	uint32_t file;
+	uint32_t pos;
+	unsigned char type;
+}index_hit_t;
+
+/* token type names understood by index_query */
+static const struct
+{
+	const char *name;
+	unsigned int mask;
+} index_types[] = {
+	{"code", TYPE_BIT(PEVENT_REGULAR_EXP) | TYPE_BIT(PEVENT_EOF)},
+	{"comment", TYPE_BIT(PEVENT_SINGLE_LINE_COMMENT) | TYPE_BIT(PEVENT_MULTI_LINE_COMMENT)},
+	{"string", TYPE_BIT(PEVENT_STRING)},
+	{"keyword", TYPE_BIT(PEVENT_RESERVE_KEYWORD)},
+	{"preprocessor", TYPE_BIT(PEVENT_PREPROCESSOR_DIRECTIVE)},
+	{"header", TYPE_BIT(PEVENT_HEADER_FILE)},
+	{"number", TYPE_BIT(PEVENT_NUMERIC_CONSTANT)},
+	{"char", TYPE_BIT(PEVENT_ASCII_CHAR)},
+};
+
+#define NUM_INDEX_TYPES (sizeof(index_types) / sizeof(index_types[0]))
+
+/********** Utility functions **********/
+
+/* append to a byte buffer, growing it when needed */
+static int index_put(unsigned char **buf, size_t *len, size_t *cap, const void *data, size_t size)
+{
+	if(*len + size > *cap)
+	{
+		size_t new_cap = *cap ? *cap * 2 : 16;
+		unsigned char *p;
+
+		while(new_cap < *len + size)
+			new_cap *= 2;
+		if((p = realloc(*buf, new_cap)) == NULL)
+			return -1;
+		*buf = p;
+		*cap = new_cap;
+	}
+	memcpy(*buf + *len, data, size);
+	*len += size;
+
+	return 0;
+}
+
+/* encode value with 7 bits per byte, high bit set => more bytes follow */
+static int index_put_varint(index_list_t *list, uint32_t value)
+{
+	unsigned char tmp[5];
+	int n = 0;
+
+	while(value >= 0x80)
+	{
+		tmp[n++] = (value & 0x7f) | 0x80;
+		value >>= 7;
+	}
+	tmp[n++] = value;
+
+	return index_put(&list->buf, &list->len, &list->cap, tmp, n);
+}
+
+/* decode one value, -1 when it runs past end or is longer than 5 bytes */
+static int index_get_varint(const unsigned char **p, const unsigned char *end, uint32_t *value)
+{
+	int shift = 0;
+
+	*value = 0;
+	while(*p < end && **p & 0x80)
+	{
+		if(shift > 21)
+			return -1;
+		*value |= (uint32_t)(*(*p)++ & 0x7f) << shift;
+		shift += 7;
+	}
+	if(*p == end)
+		return -1;
+	*value |= (uint32_t)(*(*p)++) << shift;
+
+	return 0;
+}
+
+/* the tables of the header lie inside the mapping, their entries are checked when used */
+static int index_check_header(const unsigned char *base, size_t size)
+{
+	const index_header_t *hdr = (const index_header_t *)base;
+
+	if(hdr->files_off % 8 || hdr->trigrams_off % 8 || hdr->lines_off % 4)
+		return -1;
+	if(hdr->files_off > size || (size - hdr->files_off) / sizeof(index_file_t) < hdr->num_files)
+		return -1;
+	if(hdr->trigrams_off > size || (size - hdr->trigrams_off) / sizeof(index_trigram_t) < hdr->num_trigrams)
+		return -1;
+	if(hdr->names_off > size || hdr->postings_off > size || hdr->lines_off > size)
+		return -1;
+
+	return 0;
+}
+
+/* the name and the line table of the file lie inside the mapping */
+static int index_check_file(const unsigned char *base, size_t size, const index_file_t *f)
+{
+	const index_header_t *hdr = (const index_header_t *)base;
+
+	if(f->name_off >= size - hdr->names_off ||
+			memchr(base + hdr->names_off + f->name_off, '\0', size - hdr->names_off - f->name_off) == NULL)
+		return -1;
+	if(f->lines_off % 4 || f->lines_off > size || (size - f->lines_off) / sizeof(uint32_t) < f->num_lines)
+		return -1;
+
+	return 0;
+}
+
+/* map an index file, NULL when it can not be read */
+static const unsigned char *index_map(const char *index_file, size_t *size)
+{
+	const unsigned char *base;
+	struct stat st;
+	int fd;
+
+	if((fd = open(index_file, O_RDONLY)) < 0)
+		return NULL;
+	if(fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(index_header_t))
+	{
+		close(fd);
+		return NULL;
+	}
+	base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(base == MAP_FAILED)
+		return NULL;
+	if(memcmp(base, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 || index_check_header(base, st.st_size) < 0)
+	{
+		munmap((void *)base, st.st_size);
+		return NULL;
+	}
+
+	*size = st.st_size;
+	return base;
+}
+
+/* posting list of the trigram, created when missing */
+static index_list_t *index_list(index_builder_t *idx, uint32_t trigram)
+{
+	uint32_t key = trigram + 1;
+	size_t slot, old_size, i;
+	index_list_t *old;
+
+	/* keep the table at most half full */
+	if((idx->lists_used + 1) * 2 > idx->lists_size)
+	{
+		old = idx->lists;
+		old_size = idx->lists_size;
+		idx->lists_size = old_size ? old_size * 2 : 4096;
+		if((idx->lists = calloc(idx->lists_size, sizeof(index_list_t))) == NULL)
+		{
+			idx->lists = old;
+			idx->lists_size = old_size;
+			return NULL;
+		}
+		for(i = 0; i < old_size; i++)
+		{
+			if(old[i].key == 0)
+				continue;
+			slot = (old[i].key * 2654435761u) & (idx->lists_size - 1);
+			while(idx->lists[slot].key)
+				slot = (slot + 1) & (idx->lists_size - 1);
+			idx->lists[slot] = old[i];
+		}
+		free(old);
+	}
+
+	slot = (key * 2654435761u) & (idx->lists_size - 1);
+	while(idx->lists[slot].key && idx->lists[slot].key != key)
+		slot = (slot + 1) & (idx->lists_size - 1);
+
+	if(idx->lists[slot].key == 0)
+	{
+		idx->lists[slot].key = key;
+		idx->lists_used++;
+	}
+
+	return &idx->lists[slot];
+}
+
+/* add one posting of the trigram, files must come in ascending order */
+static void index_put_posting(index_builder_t *idx, uint32_t trigram, uint32_t file, uint32_t pos, unsigned char type)
+{
+	index_list_t *list = index_list(idx, trigram);
+
+	if(list == NULL)
+		return;
+
+	if(list->count == 0 || file != list->last_file)
+	{
+		index_put_varint(list, file - list->last_file);
+		index_put_varint(list, pos);
+	}
+	else
+	{
+		index_put_varint(list, 0);
+		index_put_varint(list, pos - list->last_pos);
+	}
+	index_put(&list->buf, &list->len, &list->cap, &type, 1);
+
+	list->last_file = file;
+	list->last_pos = pos;
+	list->count++;
+}
+
+/* add one posting of the trigram in the current file */
+static void index_add_posting(index_builder_t *idx, uint32_t trigram, uint32_t pos, unsigned char type)
+{
+	index_put_posting(idx, trigram, idx->num_files - 1, pos, type);
+}
+
+/* trigrams with new lines or only blanks are not worth indexing */
+static int index_skip(unsigned char a, unsigned char b, unsigned char c)
+{
+	if(a == '\n' || b == '\n' || c == '\n')
+		return 1;
+
+	return (a == ' ' || a == '\t') && (b == ' ' || b == '\t') && (c == ' ' || c == '\t');
+}
+
+/* remember where a line of the current file starts */
+static void index_add_line(index_builder_t *idx, uint32_t pos)
+{
+	uint32_t *lines;
+
+	if(idx->lines_len == idx->lines_size)
+	{
+		if((lines = realloc(idx->lines, (idx->lines_size ? idx->lines_size * 2 : 4096) * sizeof(uint32_t))) == NULL)
+			return;
+		idx->lines = lines;
+		idx->lines_size = idx->lines_size ? idx->lines_size * 2 : 4096;
+	}
+
+	idx->lines[idx->lines_len++] = pos;
+	idx->files[idx->num_files - 1].num_lines++;
+}
+
+/********** index building functions **********/
+
+index_builder_t *index_create(void)
+{
+	return calloc(1, sizeof(index_builder_t));
+}
+
+void index_begin_file(index_builder_t *idx, const char *file_name)
+{
+	if(idx->num_files == idx->files_size)
+	{
+		idx->files_size = idx->files_size ? idx->files_size * 2 : 256;
+		idx->files = realloc(idx->files, idx->files_size * sizeof(index_file_t));
+		idx->names = realloc(idx->names, idx->files_size * sizeof(char *));
+	}
+
+	idx->names[idx->num_files] = strdup(file_name);
+	idx->files[idx->num_files].name_off = idx->num_files;
+	idx->files[idx->num_files].num_lines = 0;
+	idx->files[idx->num_files].lines_off = idx->lines_len;
+	idx->num_files++;
+
+	idx->pos = 0;
+	idx->win_len = 0;
+	index_add_line(idx, 0);
+}
+
+/* one source byte of the current file */
+static void index_add_byte(index_builder_t *idx, unsigned char c, unsigned char type)
+{
+	if(idx->win_len == 2 && !index_skip(idx->win[0], idx->win[1], c))
+		index_add_posting(idx, (idx->win[0] << 16) | (idx->win[1] << 8) | c, idx->pos - 2, idx->win_type[0]);
+
+	/* slide the window */
+	if(idx->win_len == 2)
+	{
+		idx->win[0] = idx->win[1];
+		idx->win_type[0] = idx->win_type[1];
+		idx->win[1] = c;
+		idx->win_type[1] = type;
+	}
+	else
+	{
+		idx->win[idx->win_len] = c;
+		idx->win_type[idx->win_len++] = type;
+	}
+
+	idx->pos++;
+	if(c == '\n')
+		index_add_line(idx, idx->pos);
+}
+
+/* hook called with every event of the current file */
+void index_add_event(void *ctx, pevent_t *event)
+{
+	index_builder_t *idx = ctx;
+	int std_header = (event->type == PEVENT_HEADER_FILE && event->property != USER_HEADER_FILE);
+	int i;
+
+	/* the lexer drops the brackets of a standard header, positions are in the source */
+	if(std_header)
+		index_add_byte(idx, '<', event->type);
+	for(i = 0; i < event->length; i++)
+		index_add_byte(idx, event->data[i], event->type);
+	if(std_header)
+		index_add_byte(idx, '>', event->type);
+}
+
+/* sort helper: posting lists by trigram */
+static int index_cmp_list(const void *a, const void *b)
+{
+	uint32_t ka = ((const index_list_t *)a)->key;
+	uint32_t kb = ((const index_list_t *)b)->key;
+
+	return ka < kb ? -1 : ka > kb;
+}
+
+/* write the index file, see index_header_t for the layout */
+int index_write(index_builder_t *idx, const char *index_file)
+{
+	static const char zero[8] = {0};
+	index_header_t hdr;
+	index_trigram_t tri;
+	index_file_t file;
+	uint64_t off, names_len = 0, post_len = 0;
+	size_t i, used = 0;
+	uint32_t name_off = 0;
+	FILE *fp;
+
+	/* pack the used lists to the front, sorted by trigram */
+	for(i = 0; i < idx->lists_size; i++)
+	{
+		if(idx->lists[i].key)
+			idx->lists[used++] = idx->lists[i];
+	}
+	if(used < idx->lists_size)
+		memset(idx->lists + used, 0, (idx->lists_size - used) * sizeof(index_list_t));
+	idx->lists_used = used;
+	qsort(idx->lists, used, sizeof(index_list_t), index_cmp_list);
+
+	for(i = 0; i < idx->num_files; i++)
+		names_len += strlen(idx->names[i]) + 1;
+	for(i = 0; i < used; i++)
+		post_len += idx->lists[i].len;
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, INDEX_MAGIC, sizeof(hdr.magic));
+	hdr.num_files = idx->num_files;
+	hdr.num_trigrams = used;
+	hdr.files_off = sizeof(hdr);
+	hdr.names_off = hdr.files_off + (uint64_t)idx->num_files * sizeof(index_file_t);
+	hdr.trigrams_off = (hdr.names_off + names_len + 7) & ~7ull;
+	hdr.postings_off = hdr.trigrams_off + (uint64_t)used * sizeof(index_trigram_t);
+	hdr.lines_off = (hdr.postings_off + post_len + 7) & ~7ull;
+
+	if((fp = fopen(index_file, "w")) == NULL)
+		return -1;
+
+	fwrite(&hdr, sizeof(hdr), 1, fp);
+
+	for(i = 0; i < idx->num_files; i++)
+	{
+		file = idx->files[i];
+		file.name_off = name_off;
+		file.lines_off = hdr.lines_off + idx->files[i].lines_off * sizeof(uint32_t);
+		name_off += strlen(idx->names[i]) + 1;
+		fwrite(&file, sizeof(file), 1, fp);
+	}
+
+	for(i = 0; i < idx->num_files; i++)
+		fwrite(idx->names[i], strlen(idx->names[i]) + 1, 1, fp);
+	fwrite(zero, hdr.trigrams_off - hdr.names_off - names_len, 1, fp);
+
+	for(i = 0, off = 0; i < used; i++)
+	{
+		tri.trigram = idx->lists[i].key - 1;
+		tri.count = idx->lists[i].count;
+		tri.post_off = off;
+		tri.post_len = idx->lists[i].len;
+		off += idx->lists[i].len;
+		fwrite(&tri, sizeof(tri), 1, fp);
+	}
+
+	for(i = 0; i < used; i++)
+		fwrite(idx->lists[i].buf, idx->lists[i].len, 1, fp);
+	fwrite(zero, hdr.lines_off - hdr.postings_off - post_len, 1, fp);
+
+	fwrite(idx->lines, sizeof(uint32_t), idx->lines_len, fp);
+
+	return fclose(fp) == 0 ? 0 : -1;
+}
+
+void index_destroy(index_builder_t *idx)
+{
+	size_t i;
+
+	for(i = 0; i < idx->lists_size; i++)
+		free(idx->lists[i].buf);
+	for(i = 0; i < idx->num_files; i++)
+		free(idx->names[i]);
+	free(idx->lists);
+	free(idx->files);
+	free(idx->names);
+	free(idx->lines);
+	free(idx);
+}
+
+/********** query functions **********/
+
+/* decode the posting list, positions moved back by shift, type filtered by mask,
+ * NULL when the list does not fit in the mapping or does not decode
+ */
+static index_hit_t *index_decode(const unsigned char *base, size_t size, const index_trigram_t *tri,
+		uint32_t shift, unsigned int mask, size_t *count)
+{
+	const index_header_t *hdr = (const index_header_t *)base;
+	const unsigned char *p, *end;
+	index_hit_t *hits;
+	uint32_t file = 0, pos = 0, delta, value, i;
+	unsigned char type;
+	size_t n = 0;
+
+	/* a posting takes at least three bytes */
+	if(tri->post_off > size - hdr->postings_off || tri->post_len > size - hdr->postings_off - tri->post_off ||
+			tri->count > tri->post_len / 3)
+		return NULL;
+	p = base + hdr->postings_off + tri->post_off;
+	end = p + tri->post_len;
+
+	if((hits = malloc((tri->count + 1) * sizeof(index_hit_t))) == NULL)
+		return NULL;
+
+	for(i = 0; i < tri->count; i++)
+	{
+		if(index_get_varint(&p, end, &delta) < 0 || index_get_varint(&p, end, &value) < 0 || p == end)
+			goto damaged;
+		if(delta != 0)
+		{
+			file += delta;
+			pos = value;
+		}
+		else
+		{
+			pos += value;
+		}
+		type = *p++;
+
+		if(file >= hdr->num_files || type >= 32)
+			goto damaged;
+		if(pos < shift || (mask && !(mask & TYPE_BIT(type))))
+			continue;
+		hits[n].file = file;
+		hits[n].pos = pos - shift;
+		hits[n].type = type;
+		n++;
+	}
+
+	*count = n;
+	return hits;
+
+damaged:
+	free(hits);
+	return NULL;
+}
+
+/* keep the hits of a that are also in b, both sorted by file and position */
+static size_t index_intersect(index_hit_t *a, size_t na, const index_hit_t *b, size_t nb)
+{
+	size_t i = 0, j = 0, n = 0;
+
+	while(i < na && j < nb)
+	{
+		if(a[i].file < b[j].file || (a[i].file == b[j].file && a[i].pos < b[j].pos))
+			i++;
+		else if(a[i].file == b[j].file && a[i].pos == b[j].pos)
+		{
+			a[n++] = a[i++];
+			j++;
+		}
+		else
+			j++;
+	}
+
+	return n;
+}
+
+/* binary search of the trigram table */
+static const index_trigram_t *index_find(const index_trigram_t *tris, uint32_t num, uint32_t trigram)
+{
+	uint32_t lo = 0, hi = num, mid;
+
+	while(lo < hi)
+	{
+		mid = lo + (hi - lo) / 2;
+		if(tris[mid].trigram < trigram)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return (lo < num && tris[lo].trigram == trigram) ? &tris[lo] : NULL;
+}
+
+/* line number (from 1) of the position */
+static uint32_t index_line(const uint32_t *lines, uint32_t num_lines, uint32_t pos)
+{
+	uint32_t lo = 0, hi = num_lines, mid;
+
+	while(hi - lo > 1)
+	{
+		mid = lo + (hi - lo) / 2;
+		if(lines[mid] <= pos)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	return lo + 1;
+}
+
+/* path of an indexed file: names of a batch run are below the directory of the index */
+static void index_file_path(char *path, size_t size, const char *index_file, const char *name)
+{
+	const char *slash = strrchr(index_file, '/');
+
+	if(name[0] == '/' || slash == NULL)
+		snprintf(path, size, "%s", name);
+	else
+		snprintf(path, size, "%.*s/%s", (int)(slash - index_file), index_file, name);
+}
+
+/* print line number 'line' of the source file, reading forward from the last printed line */
+static void index_print_line(FILE *fp, uint32_t *cur_line, uint32_t line)
+{
+	int ch;
+
+	while(*cur_line < line && (ch = fgetc(fp)) != EOF)
+	{
+		if(ch == '\n')
+			(*cur_line)++;
+	}
+	while((ch = fgetc(fp)) != EOF && ch != '\n')
+		putchar(ch);
+	if(ch == '\n')
+		(*cur_line)++;
+	putchar('\n');
+}
+
+int index_query(const char *index_file, const char *type_name, const char *text)
+{
+	const index_header_t *hdr;
+	const index_trigram_t *tris, *tri, *rare = NULL;
+	const index_file_t *files;
+	const unsigned char *base;
+	index_hit_t *hits = NULL, *other;
+	size_t len = strlen(text), size, i, n = 0, nother;
+	unsigned int mask = 0;
+	uint32_t trigram, rare_shift = 0, line, last_file = UINT32_MAX, last_line = 0, cur_line = 0, matched_files = 0;
+	struct timespec t0, t1;
+	FILE *src = NULL;
+
+	if(type_name)
+	{
+		for(i = 0; i < NUM_INDEX_TYPES; i++)
+		{
+			if(strcmp(index_types[i].name, type_name) == 0)
+				mask = index_types[i].mask;
+		}
+		if(mask == 0)
+		{
+			printf("Error! unknown token type %s\n", type_name);
+			return 1;
+		}
+	}
+	if(len < 3)
+	{
+		printf("Error! search text needs at least 3 characters\n");
+		return 1;
+	}
+
+	if((base = index_map(index_file, &size)) == NULL)
+	{
+		printf("Error! could not read index %s\n", index_file);
+		return 2;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+
+	hdr = (const index_header_t *)base;
+	files = (const index_file_t *)(base + hdr->files_off);
+	tris = (const index_trigram_t *)(base + hdr->trigrams_off);
+
+	/* start from the rarest trigram of the text */
+	for(i = 0; i + 2 < len; i++)
+	{
+		trigram = ((unsigned char)text[i] << 16) | ((unsigned char)text[i + 1] << 8) | (unsigned char)text[i + 2];
+		if((tri = index_find(tris, hdr->num_trigrams, trigram)) == NULL)
+			goto done; // some trigram never occurs, no match
+		if(rare == NULL || tri->count < rare->count)
+		{
+			rare = tri;
+			rare_shift = i;
+		}
+	}
+	if((hits = index_decode(base, size, rare, rare_shift, rare_shift ? 0 : mask, &n)) == NULL)
+		goto damaged;
+
+	/* every other trigram must follow at the right distance */
+	for(i = 0; i + 2 < len && n; i++)
+	{
+		if(i == rare_shift)
+			continue;
+		trigram = ((unsigned char)text[i] << 16) | ((unsigned char)text[i + 1] << 8) | (unsigned char)text[i + 2];
+		tri = index_find(tris, hdr->num_trigrams, trigram);
+		if((other = index_decode(base, size, tri, i, i ? 0 : mask, &nother)) == NULL)
+			goto damaged;
+		n = index_intersect(hits, n, other, nother);
+		free(other);
+	}
+
+done:
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	for(i = 0; i < n; i++)
+	{
+		if(i == 0 || hits[i].file != hits[i - 1].file)
+		{
+			if(i < INDEX_MAX_RESULTS && index_check_file(base, size, &files[hits[i].file]) < 0)
+				goto damaged;
+			matched_files++;
+		}
+	}
+
+	/* one result per line */
+	for(i = 0; i < n && i < INDEX_MAX_RESULTS; i++)
+	{
+		const index_file_t *f = &files[hits[i].file];
+		const char *name = (const char *)base + hdr->names_off + f->name_off;
+		char path[PATH_MAX];
+
+		line = index_line((const uint32_t *)(base + f->lines_off), f->num_lines, hits[i].pos);
+		if(hits[i].file == last_file && line == last_line)
+			continue;
+
+		index_file_path(path, sizeof(path), index_file, name);
+		if(hits[i].file != last_file)
+		{
+			if(src)
+				fclose(src);
+			src = fopen(path, "r");
+			cur_line = 1;
+		}
+		last_file = hits[i].file;
+		last_line = line;
+
+		printf("%s:%u: ", path, line);
+		if(src)
+			index_print_line(src, &cur_line, line);
+		else
+			putchar('\n');
+	}
+	if(src)
+		fclose(src);
+
+	printf("%zu matches in %u files (%.3f ms)\n", n, matched_files,
+			(t1.tv_sec - t0.tv_sec) * 1000.0 + (t1.tv_nsec - t0.tv_nsec) / 1000000.0);
+	if(n > INDEX_MAX_RESULTS)
+		printf("truncated at %d matches\n", INDEX_MAX_RESULTS);
+
+	free(hits);
+	munmap((void *)base, size);
+
+	return n ? 0 : 1;
+
+damaged:
+	printf("Error! index %s is damaged\n", index_file);
+	free(hits);
+	munmap((void *)base, size);
+
+	return 2;
+}
+/********** merge functions **********/
+
+//structure to hold one partial index while merging
+typedef struct
+{
+	const unsigned char *base;  // mapped index file
+	size_t size;
+	uint32_t *map;              // local file number => merged file number
+	uint32_t next;              // next trigram to merge
+}index_part_t;
+
+//structure to hold one file name of a partial index
+typedef struct
+{
+	const char *name;
+	uint32_t part;
+	uint32_t file;
+}index_name_t;
+
+/* sort helper: file names */
+static int index_cmp_name(const void *a, const void *b)
+{
+	return strcmp(((const index_name_t *)a)->name, ((const index_name_t *)b)->name);
+}
+
+/* sort helper: hits by file and position */
+static int index_cmp_hit(const void *a, const void *b)
+{
+	const index_hit_t *ha = a, *hb = b;
+
+	if(ha->file != hb->file)
+		return ha->file < hb->file ? -1 : 1;
+	return ha->pos < hb->pos ? -1 : ha->pos > hb->pos;
+}
+
+/* the files of every part ordered by name, as one batch run would have
+ * indexed them, the trigram tables are merged like sorted lists
+ */
+int index_merge(char **part_files, int count, const char *index_file)
+{
+	index_part_t *parts = calloc(count ? count : 1, sizeof(index_part_t));
+	index_builder_t *idx = index_create();
+	index_name_t *names = NULL, *grown_names;
+	index_hit_t *hits = NULL, *part_hits, *grown;
+	const index_header_t *hdr;
+	const index_file_t *f;
+	const index_trigram_t *tri;
+	const uint32_t *lines;
+	size_t num_names = 0, n, nhits, hits_size = 0, i;
+	uint32_t trigram, file, line;
+	int p, ret = -1;
+
+	if(parts == NULL || idx == NULL)
+		goto done;
+
+	for(p = 0; p < count; p++)
+	{
+		if((parts[p].base = index_map(part_files[p], &parts[p].size)) == NULL)
+		{
+			printf("Error! could not read index %s\n", part_files[p]);
+			goto done;
+		}
+		hdr = (const index_header_t *)parts[p].base;
+		if((parts[p].map = malloc((hdr->num_files + 1) * sizeof(uint32_t))) == NULL ||
+				(grown_names = realloc(names, (num_names + hdr->num_files + 1) * sizeof(index_name_t))) == NULL)
+			goto done;
+		names = grown_names;
+		for(file = 0; file < hdr->num_files; file++)
+		{
+			f = (const index_file_t *)(parts[p].base + hdr->files_off) + file;
+			if(index_check_file(parts[p].base, parts[p].size, f) < 0)
+			{
+				printf("Error! index %s is damaged\n", part_files[p]);
+				goto done;
+			}
+			names[num_names].name = (const char *)parts[p].base + hdr->names_off + f->name_off;
+			names[num_names].part = p;
+			names[num_names].file = file;
+			num_names++;
+		}
+	}
+
+	qsort(names, num_names, sizeof(index_name_t), index_cmp_name);
+	for(i = 0; i < num_names; i++)
+	{
+		if(i && strcmp(names[i].name, names[i - 1].name) == 0)
+		{
+			printf("Error! %s is in more than one index\n", names[i].name);
+			goto done;
+		}
+		hdr = (const index_header_t *)parts[names[i].part].base;
+		f = (const index_file_t *)(parts[names[i].part].base + hdr->files_off) + names[i].file;
+		lines = (const uint32_t *)(parts[names[i].part].base + f->lines_off);
+
+		index_begin_file(idx, names[i].name);
+		for(line = 1; line < f->num_lines; line++)
+			index_add_line(idx, lines[line]);
+		parts[names[i].part].map[names[i].file] = i;
+	}
+
+	while(1)
+	{
+		/* smallest trigram not merged yet */
+		trigram = UINT32_MAX;
+		for(p = 0, n = 0; p < count; p++)
+		{
+			hdr = (const index_header_t *)parts[p].base;
+			if(parts[p].next == hdr->num_trigrams)
+				continue;
+			tri = (const index_trigram_t *)(parts[p].base + hdr->trigrams_off) + parts[p].next;
+			if(n == 0 || tri->trigram < trigram)
+				trigram = tri->trigram;
+			n++;
+		}
+		if(n == 0)
+			break;
+
+		/* its postings of every part, in merged file numbers */
+		nhits = 0;
+		for(p = 0; p < count; p++)
+		{
+			hdr = (const index_header_t *)parts[p].base;
+			if(parts[p].next == hdr->num_trigrams)
+				continue;
+			tri = (const index_trigram_t *)(parts[p].base + hdr->trigrams_off) + parts[p].next;
+			if(tri->trigram != trigram)
+				continue;
+			parts[p].next++;
+
+			if((part_hits = index_decode(parts[p].base, parts[p].size, tri, 0, 0, &n)) == NULL)
+			{
+				printf("Error! index %s is damaged\n", part_files[p]);
+				goto done;
+			}
+			if(nhits + n > hits_size)
+			{
+				if((grown = realloc(hits, (nhits + n) * 2 * sizeof(index_hit_t))) == NULL)
+				{
+					free(part_hits);
+					goto done;
+				}
+				hits = grown;
+				hits_size = (nhits + n) * 2;
+			}
+			for(i = 0; i < n; i++)
+			{
+				hits[nhits] = part_hits[i];
+				hits[nhits++].file = parts[p].map[part_hits[i].file];
+			}
+			free(part_hits);
+		}
+
+		qsort(hits, nhits, sizeof(index_hit_t), index_cmp_hit);
+		for(i = 0; i < nhits; i++)
+			index_put_posting(idx, trigram, hits[i].file, hits[i].pos, hits[i].type);
+	}
+
+	ret = index_write(idx, index_file);
+	if(ret < 0)
+		printf("Error! could not create %s index file\n", index_file);
+
+done:
+	for(p = 0; parts && p < count; p++)
+	{
+		if(parts[p].base)
+			munmap((void *)parts[p].base, parts[p].size);
+		free(parts[p].map);
+	}
+	free(parts);
+	free(names);
+	free(hits);
+	if(idx)
+		index_destroy(idx);
+
+	return ret;
+}
+/**** End of file ****/
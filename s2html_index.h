@@ -0,0 +1,69 @@
+#ifndef S2HTML_INDEX_H
+#define S2HTML_INDEX_H
+
+#include <stdint.h>
+
+/* constants */
+
+#define INDEX_FILE_NAME		"s2html.idx" /* written at the top of the converted tree */
+#define INDEX_MAGIC			"S2HIDX1"
+#define INDEX_MAX_RESULTS	1000 /* matches printed by one query, not lines */
+
+//structure to hold the header of an index file
+typedef struct
+{
+	char magic[8];
+	uint32_t num_files;
+	uint32_t num_trigrams;
+	uint64_t files_off;     // index_file_t table
+	uint64_t names_off;     // '\0' terminated file names, relative to the index file unless absolute
+	uint64_t trigrams_off;  // index_trigram_t table, sorted by trigram
+	uint64_t postings_off;  // posting lists
+	uint64_t lines_off;     // line start offsets of every file
+}index_header_t;
+
+//structure to hold one indexed file
+typedef struct
+{
+	uint32_t name_off;      // file name in the name pool
+	uint32_t num_lines;     // entries in the line table
+	uint64_t lines_off;     // first uint32_t line start of this file
+}index_file_t;
+
+//structure to hold one trigram and its posting list
+typedef struct
+{
+	uint32_t trigram;       // three bytes, first byte highest
+	uint32_t count;         // postings in the list
+	uint64_t post_off;      // list offset in the posting area
+	uint64_t post_len;      // list size in bytes
+}index_trigram_t;
+
+/* a posting list is a sequence of
+ *   varint file delta (0 => same file as previous posting)
+ *   varint position (delta to previous posting in the same file, else absolute)
+ *   byte token type of the first byte (pevent_e)
+ * positions are byte offsets in the source file
+ */
+
+//structure to hold an index while it is built
+typedef struct index_builder index_builder_t;
+
+/********** function prototypes **********/
+
+index_builder_t *index_create(void);
+void index_begin_file(index_builder_t *idx, const char *file_name); /* following events belong to this file, see names_off */
+void index_add_event(void *idx, pevent_t *event); /* conv_hook_fn */
+int index_write(index_builder_t *idx, const char *index_file);
+void index_destroy(index_builder_t *idx);
+
+/* one index of the files of several partial indexes, like the index of
+ * a single batch run over all of them, returns -1 on failure
+ */
+int index_merge(char **part_files, int count, const char *index_file);
+
+/* print the matches of text, type_name (like "comment") may be NULL */
+int index_query(const char *index_file, const char *type_name, const char *text);
+
+#endif
+/**** End of file ****/
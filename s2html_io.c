@@ -0,0 +1,605 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#ifdef S2HTML_IO_URING
+#include <liburing.h>
+#endif
+#include "s2html_event.h"
+#include "s2html_conv.h"
+#include "s2html_io.h"
+#include "s2html_trace.h"
+
+/********** Utility functions **********/
+
+/* monotonic time in milli seconds */
+static double io_now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/* render the source held in memory into a malloc'd html buffer */
+static int io_render(const char *src_file, const char *buf, size_t len,
+		io_render_fn render, void *ctx, char **out, size_t *out_len)
+{
+	FILE *dfp;
+	int ret;
+
+	if((dfp = open_memstream(out, out_len)) == NULL)
+		return CONV_ERR_DEST;
+
+	ret = render(src_file, buf, len, dfp, ctx);
+
+	if(fclose(dfp) != 0)
+		return CONV_ERR_DEST;
+
+	return ret;
+}
+
+int io_backend_by_name(const char *name)
+{
+	if(strcmp(name, "auto") == 0)
+		return IO_BACKEND_AUTO;
+	if(strcmp(name, "blocking") == 0)
+		return IO_BACKEND_BLOCKING;
+	if(strcmp(name, "uring") == 0)
+		return IO_BACKEND_URING;
+
+	return -1;
+}
+
+const char *io_backend_name(int backend)
+{
+	switch(backend)
+	{
+		case IO_BACKEND_BLOCKING :
+			return "blocking";
+		case IO_BACKEND_URING :
+			return "uring";
+		default :
+			return "auto";
+	}
+}
+
+/********** blocking backend **********/
+
+/* read the whole file, growing the buffer if the file grew since it was listed */
+static ssize_t io_read_fd(int fd, char **buf, size_t *cap, size_t hint)
+{
+	size_t len = 0;
+	ssize_t ret;
+	char *tmp;
+
+	if(*cap < hint + 1)
+	{
+		if((tmp = realloc(*buf, hint + 1)) == NULL)
+			return -1;
+		*buf = tmp;
+		*cap = hint + 1;
+	}
+
+	while(1)
+	{
+		if(len == *cap)
+		{
+			if((tmp = realloc(*buf, *cap * 2)) == NULL)
+				return -1;
+			*buf = tmp;
+			*cap *= 2;
+		}
+		if((ret = pread(fd, *buf + len, *cap - len, len)) < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			return -1;
+		}
+		if(ret == 0)
+			break;
+		len += ret;
+	}
+
+	return len;
+}
+
+/* write the whole buffer */
+static int io_write_fd(int fd, const char *buf, size_t len)
+{
+	size_t done = 0;
+	ssize_t ret;
+
+	while(done < len)
+	{
+		if((ret = pwrite(fd, buf + done, len - done, done)) < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			return -1;
+		}
+		done += ret;
+	}
+
+	return 0;
+}
+
+static void io_blocking_convert(char **files, const long *sizes, int count,
+		io_render_fn render, void *ctx, io_stats_t *stats)
+{
+	char dest_file[PATH_MAX], tmp_file[PATH_MAX];
+	char *buf = NULL, *out;
+	size_t cap = 0, out_len;
+	ssize_t len;
+	uint64_t start;
+	int idx, fd, ret;
+
+	for(idx = 0; idx < count; idx++)
+	{
+		/* read source */
+		start = trace_begin("open", files[idx]);
+		fd = open(files[idx], O_RDONLY | O_CLOEXEC);
+		trace_end("open", files[idx], start);
+		if(fd < 0)
+		{
+			stats->failed++;
+			continue;
+		}
+		start = trace_begin("read", files[idx]);
+		len = io_read_fd(fd, &buf, &cap, sizes[idx]);
+		trace_end("read", files[idx], start);
+		start = trace_begin("close", files[idx]);
+		close(fd);
+		trace_end("close", files[idx], start);
+		if(len < 0)
+		{
+			stats->failed++;
+			continue;
+		}
+
+		/* convert */
+		out = NULL;
+		if(io_render(files[idx], buf, len, render, ctx, &out, &out_len) != CONV_OK)
+		{
+			free(out);
+			stats->failed++;
+			continue;
+		}
+
+		/* write html */
+		snprintf(dest_file, sizeof(dest_file), "%s.html", files[idx]);
+		conv_tmp_name(tmp_file, sizeof(tmp_file), dest_file);
+		start = trace_begin("open", dest_file);
+		fd = open(tmp_file, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+		trace_end("open", dest_file, start);
+		if(fd < 0)
+		{
+			free(out);
+			stats->failed++;
+			continue;
+		}
+		start = trace_begin("flush", dest_file);
+		ret = io_write_fd(fd, out, out_len);
+		trace_end("flush", dest_file, start);
+		start = trace_begin("close", dest_file);
+		if(ret < 0 || close(fd) < 0 || rename(tmp_file, dest_file) < 0)
+			ret = -1;
+		trace_end("close", dest_file, start);
+		if(ret < 0)
+		{
+			unlink(tmp_file);
+			free(out);
+			stats->failed++;
+			continue;
+		}
+
+		stats->files++;
+		stats->bytes_in += len;
+		stats->bytes_out += out_len;
+		free(out);
+	}
+
+	free(buf);
+}
+
+/********** io_uring backend **********/
+
+#ifdef S2HTML_IO_URING
+
+/* stage of a file in flight */
+typedef enum
+{
+	IO_STAGE_FREE,
+	IO_STAGE_OPEN_SRC,
+	IO_STAGE_READ,
+	IO_STAGE_OPEN_DEST,
+	IO_STAGE_WRITE,
+	IO_STAGE_CLOSE_DEST,
+	IO_STAGE_RENAME
+}io_stage_e;
+
+//structure to hold one file in flight
+typedef struct
+{
+	io_stage_e stage;
+	int file;                 // index into file list
+	int fd;
+	int buf_index;            // registered buffer of this slot
+	char *buf;                // read buffer, registered one or malloc'd for big files
+	size_t cap;
+	size_t len;
+	char *out;                // rendered html
+	size_t out_len;
+	size_t out_done;
+	char dest_file[PATH_MAX];
+	char tmp_file[PATH_MAX];
+}io_slot_t;
+
+//structure to hold the state of a uring run
+typedef struct
+{
+	struct io_uring ring;
+	io_slot_t slots[IO_QUEUE_DEPTH];
+	char *pool;               // registered buffers, IO_BUF_SIZE per slot
+	int inflight;             // submitted requests not yet completed
+	int next_file;
+	char **files;
+	const long *sizes;
+	int count;
+	io_render_fn render;
+	void *ctx;
+	io_stats_t *stats;
+}io_uring_run_t;
+
+/* get a submission entry, flushing the queue when it is full, the
+ * caller sets the data after the prep call, which may clear it
+ */
+static struct io_uring_sqe *io_get_sqe(io_uring_run_t *run)
+{
+	struct io_uring_sqe *sqe;
+
+	while((sqe = io_uring_get_sqe(&run->ring)) == NULL)
+		io_uring_submit(&run->ring);
+
+	run->inflight++;
+
+	return sqe;
+}
+
+/* release the buffers of the slot and start the next file in it */
+static void io_slot_next(io_uring_run_t *run, io_slot_t *slot, int failed)
+{
+	struct io_uring_sqe *sqe;
+
+	if(failed)
+		run->stats->failed++;
+	if(slot->buf != run->pool + (size_t)slot->buf_index * IO_BUF_SIZE)
+		free(slot->buf);
+	slot->buf = run->pool + (size_t)slot->buf_index * IO_BUF_SIZE;
+	free(slot->out);
+	slot->out = NULL;
+	slot->stage = IO_STAGE_FREE;
+
+	if(run->next_file >= run->count)
+		return;
+
+	slot->file = run->next_file++;
+	slot->len = 0;
+	slot->out_done = 0;
+
+	/* files bigger than the registered buffer get their own buffer */
+	if(run->sizes[slot->file] < IO_BUF_SIZE)
+	{
+		slot->cap = IO_BUF_SIZE;
+	}
+	else
+	{
+		slot->cap = run->sizes[slot->file] + 1;
+		if((slot->buf = malloc(slot->cap)) == NULL)
+		{
+			io_slot_next(run, slot, 1);
+			return;
+		}
+	}
+
+	slot->stage = IO_STAGE_OPEN_SRC;
+	sqe = io_get_sqe(run);
+	io_uring_prep_openat(sqe, AT_FDCWD, run->files[slot->file], O_RDONLY | O_CLOEXEC, 0);
+	io_uring_sqe_set_data(sqe, slot);
+}
+
+/* queue the next read into the slot buffer */
+static void io_slot_read(io_uring_run_t *run, io_slot_t *slot)
+{
+	struct io_uring_sqe *sqe = io_get_sqe(run);
+
+	if(slot->buf == run->pool + (size_t)slot->buf_index * IO_BUF_SIZE)
+		io_uring_prep_read_fixed(sqe, slot->fd, slot->buf + slot->len, slot->cap - slot->len,
+				slot->len, slot->buf_index);
+	else
+		io_uring_prep_read(sqe, slot->fd, slot->buf + slot->len, slot->cap - slot->len, slot->len);
+	io_uring_sqe_set_data(sqe, slot);
+}
+
+/* move the data read so far into a malloc'd buffer twice as big */
+static int io_slot_grow(io_uring_run_t *run, io_slot_t *slot)
+{
+	char *buf;
+
+	if(slot->buf == run->pool + (size_t)slot->buf_index * IO_BUF_SIZE)
+	{
+		if((buf = malloc(slot->cap * 2)) == NULL)
+			return -1;
+		memcpy(buf, slot->buf, slot->len);
+	}
+	else if((buf = realloc(slot->buf, slot->cap * 2)) == NULL)
+		return -1;
+
+	slot->buf = buf;
+	slot->cap *= 2;
+
+	return 0;
+}
+
+/* close without waiting for the result */
+static void io_close_async(io_uring_run_t *run, int fd)
+{
+	struct io_uring_sqe *sqe = io_get_sqe(run);
+
+	io_uring_prep_close(sqe, fd);
+	io_uring_sqe_set_data(sqe, NULL);
+}
+
+/* source is in memory: convert it while other files are still in flight */
+static void io_slot_convert(io_uring_run_t *run, io_slot_t *slot)
+{
+	struct io_uring_sqe *sqe;
+	const char *src_file = run->files[slot->file];
+
+	/* hand the requests queued so far to the kernel first, so the other slots
+	 * keep reading and writing while this one is busy converting
+	 */
+	io_uring_submit(&run->ring);
+
+	if(io_render(src_file, slot->buf, slot->len, run->render, run->ctx,
+				&slot->out, &slot->out_len) != CONV_OK)
+	{
+		io_slot_next(run, slot, 1);
+		return;
+	}
+	run->stats->bytes_in += slot->len;
+
+	snprintf(slot->dest_file, PATH_MAX, "%s.html", src_file);
+	conv_tmp_name(slot->tmp_file, PATH_MAX, slot->dest_file);
+
+	slot->stage = IO_STAGE_OPEN_DEST;
+	sqe = io_get_sqe(run);
+	io_uring_prep_openat(sqe, AT_FDCWD, slot->tmp_file, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	io_uring_sqe_set_data(sqe, slot);
+}
+
+/* move the slot to its next stage with the result of the finished request */
+static void io_slot_complete(io_uring_run_t *run, io_slot_t *slot, int res)
+{
+	struct io_uring_sqe *sqe;
+
+	switch(slot->stage)
+	{
+		case IO_STAGE_OPEN_SRC :
+			if(res < 0)
+			{
+				io_slot_next(run, slot, 1);
+				break;
+			}
+			slot->fd = res;
+			slot->stage = IO_STAGE_READ;
+			io_slot_read(run, slot);
+			break;
+
+		case IO_STAGE_READ :
+			if(res < 0)
+			{
+				io_close_async(run, slot->fd);
+				io_slot_next(run, slot, 1);
+				break;
+			}
+			slot->len += res;
+			/* a short read of a regular file is its end, a full buffer means the file
+			 * grew since it was listed: read on into a bigger buffer instead of truncating
+			 */
+			if(res > 0 && slot->len == slot->cap)
+			{
+				if(io_slot_grow(run, slot) < 0)
+				{
+					io_close_async(run, slot->fd);
+					io_slot_next(run, slot, 1);
+					break;
+				}
+				io_slot_read(run, slot);
+				break;
+			}
+			io_close_async(run, slot->fd);
+			io_slot_convert(run, slot);
+			break;
+
+		case IO_STAGE_OPEN_DEST :
+			if(res < 0)
+			{
+				io_slot_next(run, slot, 1);
+				break;
+			}
+			slot->fd = res;
+			slot->stage = IO_STAGE_WRITE;
+			res = 0;
+			/* fall through to write the first piece */
+
+		case IO_STAGE_WRITE :
+			if(res < 0)
+			{
+				io_close_async(run, slot->fd);
+				unlink(slot->tmp_file);
+				io_slot_next(run, slot, 1);
+				break;
+			}
+			slot->out_done += res;
+			sqe = io_get_sqe(run);
+			if(slot->out_done < slot->out_len)
+			{
+				io_uring_prep_write(sqe, slot->fd, slot->out + slot->out_done,
+						slot->out_len - slot->out_done, slot->out_done);
+			}
+			else
+			{
+				slot->stage = IO_STAGE_CLOSE_DEST;
+				io_uring_prep_close(sqe, slot->fd);
+			}
+			io_uring_sqe_set_data(sqe, slot);
+			break;
+
+		case IO_STAGE_CLOSE_DEST :
+			if(res < 0)
+			{
+				unlink(slot->tmp_file);
+				io_slot_next(run, slot, 1);
+				break;
+			}
+			slot->stage = IO_STAGE_RENAME;
+			sqe = io_get_sqe(run);
+			io_uring_prep_renameat(sqe, AT_FDCWD, slot->tmp_file, AT_FDCWD, slot->dest_file, 0);
+			io_uring_sqe_set_data(sqe, slot);
+			break;
+
+		case IO_STAGE_RENAME :
+			if(res < 0)
+			{
+				unlink(slot->tmp_file);
+				io_slot_next(run, slot, 1);
+				break;
+			}
+			run->stats->files++;
+			run->stats->bytes_out += slot->out_len;
+			io_slot_next(run, slot, 0);
+			break;
+
+		default :
+			break;
+	}
+}
+
+static int io_uring_convert(char **files, const long *sizes, int count,
+		io_render_fn render, void *ctx, io_stats_t *stats)
+{
+	struct iovec iov[IO_QUEUE_DEPTH];
+	struct io_uring_cqe *cqe;
+	io_uring_run_t *run;
+	unsigned head, seen;
+	uint64_t start;
+	int idx;
+
+	if((run = calloc(1, sizeof(io_uring_run_t))) == NULL)
+		return -1;
+	if(io_uring_queue_init(IO_QUEUE_DEPTH * 4, &run->ring, 0) < 0)
+	{
+		free(run);
+		return -1;
+	}
+
+	/* one registered read buffer per slot */
+	if((run->pool = aligned_alloc(4096, (size_t)IO_QUEUE_DEPTH * IO_BUF_SIZE)) == NULL)
+	{
+		io_uring_queue_exit(&run->ring);
+		free(run);
+		return -1;
+	}
+	for(idx = 0; idx < IO_QUEUE_DEPTH; idx++)
+	{
+		iov[idx].iov_base = run->pool + (size_t)idx * IO_BUF_SIZE;
+		iov[idx].iov_len = IO_BUF_SIZE;
+	}
+	if(io_uring_register_buffers(&run->ring, iov, IO_QUEUE_DEPTH) < 0)
+	{
+		io_uring_queue_exit(&run->ring);
+		free(run->pool);
+		free(run);
+		return -1;
+	}
+
+	run->files = files;
+	run->sizes = sizes;
+	run->count = count;
+	run->render = render;
+	run->ctx = ctx;
+	run->stats = stats;
+
+	for(idx = 0; idx < IO_QUEUE_DEPTH; idx++)
+	{
+		run->slots[idx].buf_index = idx;
+		run->slots[idx].buf = run->pool + (size_t)idx * IO_BUF_SIZE;
+		io_slot_next(run, &run->slots[idx], 0);
+	}
+
+	/* keep the ring busy until every file went through all stages */
+	while(run->inflight)
+	{
+		start = trace_begin("io_uring wait", NULL);
+		io_uring_submit_and_wait(&run->ring, 1);
+		trace_end("io_uring wait", NULL, start);
+
+		seen = 0;
+		io_uring_for_each_cqe(&run->ring, head, cqe)
+		{
+			seen++;
+			run->inflight--;
+			if(io_uring_cqe_get_data(cqe))
+				io_slot_complete(run, io_uring_cqe_get_data(cqe), cqe->res);
+		}
+		io_uring_cq_advance(&run->ring, seen);
+	}
+
+	io_uring_unregister_buffers(&run->ring);
+	io_uring_queue_exit(&run->ring);
+	free(run->pool);
+	free(run);
+
+	return 0;
+}
+
+#endif /* S2HTML_IO_URING */
+
+/********** I/O functions **********/
+
+int io_convert_files(char **files, const long *sizes, int count, int backend,
+		io_render_fn render, void *ctx, io_stats_t *stats)
+{
+	double start = io_now_ms();
+
+	memset(stats, 0, sizeof(io_stats_t));
+
+#ifdef S2HTML_IO_URING
+	if(backend != IO_BACKEND_BLOCKING)
+	{
+		if(io_uring_convert(files, sizes, count, render, ctx, stats) == 0)
+		{
+			stats->msec = io_now_ms() - start;
+			return IO_BACKEND_URING;
+		}
+		if(backend == IO_BACKEND_URING)
+			printf("Warning! io_uring is not available, using blocking I/O\n");
+	}
+#else
+	if(backend == IO_BACKEND_URING)
+		printf("Warning! built without io_uring support, using blocking I/O\n");
+#endif
+
+	io_blocking_convert(files, sizes, count, render, ctx, stats);
+	stats->msec = io_now_ms() - start;
+
+	return IO_BACKEND_BLOCKING;
+}
+/**** End of file ****/
@@ -0,0 +1,37 @@
+#ifndef S2HTML_IO_H
+#define S2HTML_IO_H
+
+#include <stdio.h>
+
+/* I/O backends used to convert many files */
+#define IO_BACKEND_AUTO		0 /* io_uring when available, else blocking */
+#define IO_BACKEND_BLOCKING	1 /* one file at a time with open/pread/pwrite */
+#define IO_BACKEND_URING	2 /* many files in flight with io_uring */
+
+#define IO_QUEUE_DEPTH	64        /* files in flight with io_uring */
+#define IO_BUF_SIZE		(64 * 1024) /* registered read buffer per file in flight */
+
+/* writes the html of one source file held in memory into dfp */
+typedef int (*io_render_fn)(const char *src_file, const char *buf, size_t len, FILE *dfp, void *ctx);
+
+//structure to hold the statistics of one run
+typedef struct
+{
+	long files;     // files converted
+	long failed;    // files that could not be read or written
+	long bytes_in;  // source bytes read
+	long bytes_out; // html bytes written
+	double msec;    // wall time
+}io_stats_t;
+
+/********** function prototypes **********/
+
+int io_backend_by_name(const char *name); /* -1 if unknown */
+const char *io_backend_name(int backend);
+
+/* convert every file into <file>.html, returns the backend that was used */
+int io_convert_files(char **files, const long *sizes, int count, int backend,
+		io_render_fn render, void *ctx, io_stats_t *stats);
+
+#endif
+/**** End of file ****/
@@ -0,0 +1,67 @@
+#include <stdio.h>
+#include <string.h>
+#include "s2html_event.h"
+#include "s2html_lang.h"
+
+/********** language definitions **********
+ * Languages are described in languages.def, which tools/gen_lang
+ * compiles into the read-only tables of s2html_lang_tables.c at
+ * build time. The first entry is used for unknown extensions.
+ ******************************************/
+
+/* language of the file being parsed by this thread */
+static __thread const lang_t *current_lang = NULL;
+
+/************ Language functions **********/
+
+/* find the language of the file name, NULL if the extension is unknown */
+const lang_t *lang_lookup(const char *file_name)
+{
+	const char *ext = strrchr(file_name, '.');
+	int idx, e;
+
+	if(ext == NULL || strchr(ext, '/'))
+		return NULL;
+
+	for(idx = 0; idx < lang_count; idx++)
+	{
+		for(e = 0; lang_table[idx].extensions[e]; e++)
+		{
+			if(strcmp(lang_table[idx].extensions[e], ext) == 0)
+				return &lang_table[idx];
+		}
+	}
+
+	return NULL;
+}
+
+/* select the language by the extension of the file name */
+const lang_t *lang_select(const char *file_name)
+{
+	if((current_lang = lang_lookup(file_name)) == NULL)
+		current_lang = &lang_table[0]; // default language
+
+	return current_lang;
+}
+
+const lang_t *lang_current(void)
+{
+	if(current_lang == NULL)
+		current_lang = &lang_table[0];
+
+	return current_lang;
+}
+
+/* function to check if given word is reserved key word, the hash is
+ * perfect so a single slot has to be compared
+ */
+int lang_keyword(const lang_t *lang, const char *word)
+{
+	const lang_kword_t *slot = &lang->kwords[lang_hash(lang->kword_seed, word) & lang->kword_mask];
+
+	if(slot->word && strcmp(slot->word, word) == 0)
+		return slot->type;
+
+	return 0; // word did not match, return false
+}
+/**** End of file ****/
@@ -0,0 +1,64 @@
+#ifndef S2HTML_LANG_H
+#define S2HTML_LANG_H
+
+/* character classes used by the parser */
+#define CCLASS_OPERATOR		0x01
+#define CCLASS_SYMBOL		0x02
+
+/* language flags, see languages.def */
+#define LANG_C_COMMENTS		0x01 /* // and slash star comments */
+#define LANG_SIZED_LITERALS	0x02 /* numbers like 8'hFF */
+#define LANG_SINGLE_QUOTES	0x04 /* '...' is a string without escapes */
+#define LANG_DOLLAR_VARS	0x08 /* $#, $? and ${...} are plain text */
+
+//structure to hold one slot of the keyword table
+typedef struct
+{
+	const char *word;   // NULL => empty slot
+	int type;           // RES_KEYWORD_DATA or RES_KEYWORD_NON_DATA
+}lang_kword_t;
+
+//structure to hold the definition of one language, generated from languages.def
+typedef struct
+{
+	const char *name;              // language name
+	const char *const *extensions; // file extensions, NULL terminated
+	char directive_char;           // starts a preprocessor directive, 0 if none
+	char line_comment_char;        // starts a single line comment, 0 if none
+	int flags;                     // LANG_*
+	unsigned int kword_seed;       // seed of the perfect hash of the keywords
+	unsigned int kword_mask;       // slots of kwords - 1
+	const lang_kword_t *kwords;    // keyword table, one probe per lookup
+	unsigned char char_class[256]; // CCLASS_* of every character
+}lang_t;
+
+/* tables of s2html_lang_tables.c, written by tools/gen_lang */
+extern const lang_t lang_table[];
+extern const int lang_count;
+
+/* hash of the keyword tables, shared with tools/gen_lang */
+static inline unsigned int lang_hash(unsigned int seed, const char *word)
+{
+	unsigned int h = 2166136261u ^ (seed * 0x9e3779b9u);
+
+	while(*word)
+	{
+		h ^= (unsigned char)*word++;
+		h *= 16777619u;
+	}
+	h ^= h >> 15;
+	h *= 0x2c1b3c6du;
+	h ^= h >> 12;
+
+	return h;
+}
+
+/********** function prototypes **********/
+
+const lang_t *lang_lookup(const char *file_name); /* NULL if the extension is unknown */
+const lang_t *lang_select(const char *file_name); /* select language of next file from its extension */
+const lang_t *lang_current(void);
+int lang_keyword(const lang_t *lang, const char *word); /* returns RES_KEYWORD_DATA, RES_KEYWORD_NON_DATA or 0 */
+
+#endif
+/**** End of file ****/
@@ -1,75 +1,223 @@
 
+#define _GNU_SOURCE
 #include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <sys/stat.h>
 #include "s2html_event.h"
 #include "s2html_conv.h"
-#include "s2html_conv.c"
-#include "s2html_event.c"
+#include "s2html_lang.h"
+#include "s2html_pool.h"
+#include "s2html_watch.h"
+#include "s2html_io.h"
+#include "s2html_batch.h"
+#include "s2html_diff.h"
+#include "s2html_index.h"
+#include "s2html_render.h"
+#include "s2html_trace.h"
+#include "s2html_view.h"
+#include "s2html_cache.h"
+#include "s2html_shard.h"
 
 /********** main **********/
 
 int main (int argc, char *argv[])
 {
-	FILE * sfp, *dfp; // source and destination file descriptors 
-	pevent_t *event;   //structure pointer
-	char dest_file[100];  // array to hold the dest file name
+	char dest_file[PATH_MAX];  // array to hold the dest file name
+	struct stat st;
+	int jobs = 0;              // rendering threads of a single file, 0 => by file size
+	int ret;
 
     //checking if user has passed required number of arguments
 	if(argc < 2)
 	{
 		printf("\nError ! please enter file name and mode\n");
-		printf("Usage: <executable> <file name> \n");
+		printf("Usage: <executable> [--trace <json file>] [--jobs N] <file name> [output name]\n");
+		printf("       <executable> --watch <directory>\n");
+		printf("       <executable> --batch <directory> [--io auto|blocking|uring] [--index] [--cache-mb N] [--shard i/N]\n");
+		printf("       <executable> --merge <directory> N\n");
+		printf("       <executable> --query <index file> [code|comment|string|keyword|...] <text>\n");
+		printf("       <executable> --diff <old file> <new file> [output name]\n");
+		printf("       <executable> --view <file> [output name]\n");
+		printf("--trace writes the time spent in every phase as a chrome trace, it goes before the mode\n");
 		printf("Example : ./a.out abc.txt\n\n");
 		return 1;
 	}
-#ifdef DEBUG
-	printf("File to be opened : %s\n", argv[1]);
-#endif
 
-	/* opnen the file */
-	if(NULL == (sfp = fopen(argv[1], "r")))
+	/* record the phases of the run */
+	if(strcmp(argv[1], "--trace") == 0)
 	{
-		printf("Error! File %s could not be opened\n", argv[1]);
-		return 2;
+		if(argc < 4 || trace_open(argv[2]) < 0)
+		{
+			printf("Error ! please enter the trace file and the mode\n");
+			return 1;
+		}
+		argc -= 2;
+		argv += 2;
 	}
-	/* Check for output file */
-	if (argc > 2)
+
+	/* number of threads rendering a single file */
+	if(strcmp(argv[1], "--jobs") == 0)
 	{
-		sprintf(dest_file, "%s.html", argv[2]);
+		if(argc < 4 || (jobs = atoi(argv[2])) <= 0)
+		{
+			printf("Error ! please enter the number of jobs and the file name\n");
+			return 1;
+		}
+		argc -= 2;
+		argv += 2;
 	}
-	else
+
+	/* keep converting the files of a directory as they change */
+	if(strcmp(argv[1], "--watch") == 0)
 	{
-		sprintf(dest_file, "%s.html", argv[1]);
+		if(argc < 3)
+		{
+			printf("Error ! please enter the directory to watch\n");
+			return 1;
+		}
+		return watch_tree(argv[2], 0);
 	}
-	/* open dest file */
-	if (NULL == (dfp = fopen(dest_file, "w")))
+
+	/* side by side diff of two versions of a file */
+	if(strcmp(argv[1], "--diff") == 0)
 	{
-		printf("Error! could not create %s output file\n", dest_file);
-		return 3;
+		if(argc < 4)
+		{
+			printf("Error ! please enter the old and the new file\n");
+			return 1;
+		}
+		snprintf(dest_file, sizeof(dest_file), "%s.html", argc > 4 ? argv[4] : argv[3]);
+		return diff_files(argv[2], argv[3], dest_file);
 	}
 
-	/* write HTML starting Tags */
-	html_begin(dfp, HTML_OPEN);
+	/* page that builds only the visible lines, for very big files */
+	if(strcmp(argv[1], "--view") == 0)
+	{
+		if(argc < 3)
+		{
+			printf("Error ! please enter the file name\n");
+			return 1;
+		}
+		snprintf(dest_file, sizeof(dest_file), "%s.html", argc > 3 ? argv[3] : argv[2]);
+		switch(view_file(argv[2], dest_file))
+		{
+			case CONV_ERR_SOURCE:
+				printf("Error! File %s could not be opened\n", argv[2]);
+				return 2;
 
-	/* Read from src file convert into html and write to dest file */
+			case CONV_ERR_DEST:
+				printf("Error! could not create %s output file\n", dest_file);
+				return 3;
+		}
+		printf("\nOutput file %s generated\n", dest_file);
+		return 0;
+	}
 
-	do
+	/* search the index written by --batch --index */
+	if(strcmp(argv[1], "--query") == 0)
 	{
-		event = get_parser_event(sfp);
-		/* call sourc_to_html */
-      //  printf(": %s\n", event ->data);
+		if(argc < 4)
+		{
+			printf("Error ! please enter the index file and the text to search\n");
+			return 1;
+		}
+		return index_query(argv[2], argc > 4 ? argv[3] : NULL, argv[argc > 4 ? 4 : 3]);
+	}
 
-		source_to_html(dfp, event);
-	//	printf("In main : Event = %d\n", event);
+	/* convert every source file of a directory */
+	if(strcmp(argv[1], "--batch") == 0)
+	{
+		batch_opts_t opts = {IO_BACKEND_AUTO, 0, CACHE_DEFAULT_MB, 0, 0};
+		int idx;
 
-	} while (event->type != PEVENT_EOF);
+		if(argc < 3)
+		{
+			printf("Error ! please enter the directory to convert\n");
+			return 1;
+		}
+		for(idx = 3; idx < argc; idx++)
+		{
+			if(strcmp(argv[idx], "--io") == 0 && idx + 1 < argc)
+			{
+				if((opts.io_backend = io_backend_by_name(argv[++idx])) < 0)
+				{
+					printf("Error ! unknown I/O backend %s\n", argv[idx]);
+					return 1;
+				}
+			}
+			else if(strcmp(argv[idx], "--index") == 0)
+			{
+				opts.index = 1;
+			}
+			else if(strcmp(argv[idx], "--cache-mb") == 0 && idx + 1 < argc)
+			{
+				opts.cache_mb = atoi(argv[++idx]);
+			}
+			else if(strcmp(argv[idx], "--shard") == 0 && idx + 1 < argc)
+			{
+				if(shard_parse(argv[++idx], &opts.shard, &opts.shards) < 0)
+				{
+					printf("Error ! please enter the shard as i/N with 0 <= i < N <= %d\n", SHARD_MAX);
+					return 1;
+				}
+			}
+			else
+			{
+				printf("Error ! unknown option %s\n", argv[idx]);
+				return 1;
+			}
+		}
+		return batch_run(argv[2], &opts);
+	}
+
+	/* combine the outputs of the shards of a --batch --shard run */
+	if(strcmp(argv[1], "--merge") == 0)
+	{
+		int shards;
+
+		if(argc < 4 || (shards = atoi(argv[3])) <= 0 || shards > SHARD_MAX)
+		{
+			printf("Error ! please enter the directory and the number of shards\n");
+			return 1;
+		}
+		return shard_merge(argv[2], shards);
+	}
+#ifdef DEBUG
+	printf("File to be opened : %s\n", argv[1]);
+#endif
+
+	/* Check for output file */
+	if (argc > 2)
+	{
+		snprintf(dest_file, sizeof(dest_file), "%s.html", argv[2]);
+	}
+	else
+	{
+		snprintf(dest_file, sizeof(dest_file), "%s.html", argv[1]);
+	}
+
+	/* Read from src file convert into html and write to dest file,
+	 * big files are rendered by several threads
+	 */
+	if(jobs > 1 || (jobs == 0 && stat(argv[1], &st) == 0 && st.st_size >= RENDER_PARALLEL_MIN_SIZE))
+		ret = render_file_parallel(argv[1], dest_file, jobs, 0);
+	else
+		ret = convert_file(argv[1], dest_file);
+
+	switch(ret)
+	{
+		case CONV_ERR_SOURCE:
+			printf("Error! File %s could not be opened\n", argv[1]);
+			return 2;
+
+		case CONV_ERR_DEST:
+			printf("Error! could not create %s output file\n", dest_file);
+			return 3;
+	}
 
-	/* Call start_or_end_conv function for ending the convertation */
-	html_end(dfp, HTML_CLOSE);
-	
 	printf("\nOutput file %s generated\n", dest_file);
-/* close file */
-	fclose(sfp);
-	fclose(dfp);
 
 	return 0;
 }
@@ -0,0 +1,142 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "s2html_pool.h"
+#include "s2html_trace.h"
+
+/********** worker thread **********/
+
+static void *pool_worker(void *arg)
+{
+	pool_t *pool = arg;
+	pool_job_t *job;
+	uint64_t start;
+
+	pthread_mutex_lock(&pool->lock);
+	while(1)
+	{
+		start = trace_begin("pool idle", NULL);
+		while(pool->head == NULL && !pool->stop)
+			pthread_cond_wait(&pool->job_cond, &pool->lock);
+		trace_end("pool idle", NULL, start);
+
+		if(pool->head == NULL) // stopped and nothing left to do
+			break;
+
+		/* take the job from queue and run it without the lock */
+		job = pool->head;
+		if((pool->head = job->next) == NULL)
+			pool->tail = NULL;
+		pthread_mutex_unlock(&pool->lock);
+
+		trace_end("pool queued", NULL, job->queued);
+		start = trace_begin("pool job", NULL);
+		job->fn(job->arg);
+		trace_end("pool job", NULL, start);
+		free(job);
+
+		pthread_mutex_lock(&pool->lock);
+		if(--pool->pending == 0)
+			pthread_cond_broadcast(&pool->done_cond);
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	return NULL;
+}
+
+/********** pool functions **********/
+
+pool_t *pool_create(int num_threads)
+{
+	pool_t *pool;
+	int idx;
+
+	if(num_threads <= 0)
+		num_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	if(num_threads <= 0)
+		num_threads = 1;
+
+	if((pool = calloc(1, sizeof(pool_t))) == NULL)
+		return NULL;
+	if((pool->threads = calloc(num_threads, sizeof(pthread_t))) == NULL)
+	{
+		free(pool);
+		return NULL;
+	}
+
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->job_cond, NULL);
+	pthread_cond_init(&pool->done_cond, NULL);
+
+	for(idx = 0; idx < num_threads; idx++)
+	{
+		if(pthread_create(&pool->threads[idx], NULL, pool_worker, pool) != 0)
+			break;
+	}
+	pool->num_threads = idx;
+
+	if(pool->num_threads == 0)
+	{
+		pool_destroy(pool);
+		return NULL;
+	}
+
+	return pool;
+}
+
+int pool_submit(pool_t *pool, pool_fn_t fn, void *arg)
+{
+	pool_job_t *job;
+
+	if((job = malloc(sizeof(pool_job_t))) == NULL)
+		return -1;
+	job->fn = fn;
+	job->arg = arg;
+	job->next = NULL;
+	job->queued = trace_begin("pool queued", NULL);
+
+	pthread_mutex_lock(&pool->lock);
+	if(pool->tail)
+		pool->tail->next = job;
+	else
+		pool->head = job;
+	pool->tail = job;
+	pool->pending++;
+	pthread_cond_signal(&pool->job_cond);
+	pthread_mutex_unlock(&pool->lock);
+
+	return 0;
+}
+
+void pool_wait(pool_t *pool)
+{
+	uint64_t start = trace_begin("pool wait", NULL);
+
+	pthread_mutex_lock(&pool->lock);
+	while(pool->pending)
+		pthread_cond_wait(&pool->done_cond, &pool->lock);
+	pthread_mutex_unlock(&pool->lock);
+	trace_end("pool wait", NULL, start);
+}
+
+/* finish queued jobs and free the pool */
+void pool_destroy(pool_t *pool)
+{
+	int idx;
+
+	pthread_mutex_lock(&pool->lock);
+	pool->stop = 1;
+	pthread_cond_broadcast(&pool->job_cond);
+	pthread_mutex_unlock(&pool->lock);
+
+	for(idx = 0; idx < pool->num_threads; idx++)
+		pthread_join(pool->threads[idx], NULL);
+
+	pthread_mutex_destroy(&pool->lock);
+	pthread_cond_destroy(&pool->job_cond);
+	pthread_cond_destroy(&pool->done_cond);
+	free(pool->threads);
+	free(pool);
+}
+/**** End of file ****/
@@ -0,0 +1,40 @@
+#ifndef S2HTML_POOL_H
+#define S2HTML_POOL_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+/* job run by the pool threads */
+typedef void (*pool_fn_t)(void *arg);
+
+typedef struct pool_job
+{
+	pool_fn_t fn;           // function to run
+	void *arg;              // argument passed to fn
+	uint64_t queued;        // trace_begin of the time spent in queue
+	struct pool_job *next;  // next job in queue
+}pool_job_t;
+
+//structure to hold the thread pool
+typedef struct
+{
+	pthread_t *threads;     // worker threads
+	int num_threads;        // number of worker threads
+	pool_job_t *head;       // job queue
+	pool_job_t *tail;
+	int pending;            // jobs queued or running
+	int stop;               // set when the pool is destroyed
+	pthread_mutex_t lock;
+	pthread_cond_t job_cond;  // signalled when a job is queued
+	pthread_cond_t done_cond; // signalled when pending drops to 0
+}pool_t;
+
+/********** function prototypes **********/
+
+pool_t *pool_create(int num_threads); /* num_threads <= 0 => one thread per online CPU */
+int pool_submit(pool_t *pool, pool_fn_t fn, void *arg);
+void pool_wait(pool_t *pool); /* wait until all submitted jobs are finished */
+void pool_destroy(pool_t *pool);
+
+#endif
+/**** End of file ****/
@@ -0,0 +1,324 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include "s2html_event.h"
+#include "s2html_conv.h"
+#include "s2html_lang.h"
+#include "s2html_pool.h"
+#include "s2html_render.h"
+#include "s2html_trace.h"
+
+//structure to hold all tokens of a file
+typedef struct
+{
+	pevent_e *types;
+	int *properties;
+	long *offsets;      // data offset in text
+	int *lengths;
+	int count;
+	int size;
+	char *text;         // data of all tokens
+	long text_len;
+	long text_size;
+}render_tokens_t;
+
+//structure to hold one chunk of tokens rendered by one job
+typedef struct
+{
+	render_tokens_t *toks;
+	int first;          // first token
+	int last;           // one past the last token
+	size_t length;      // html bytes of the chunk
+	off_t offset;       // where the chunk goes in the output file
+	int fd;             // output file
+	int error;
+}render_chunk_t;
+
+/********** Utility functions **********/
+
+/* make room for one more batch of events */
+static int render_reserve(render_tokens_t *toks)
+{
+	int size = toks->size ? toks->size * 2 : 65536;
+	long text_size = toks->text_size ? toks->text_size * 2 : 1024 * 1024;
+	pevent_e *types;
+	int *properties, *lengths;
+	long *offsets;
+	char *text;
+
+	/* arrays that grew stay with toks on failure, size only moves when all did */
+	if(toks->size - toks->count < RENDER_BATCH_EVENTS)
+	{
+		if((types = realloc(toks->types, size * sizeof(pevent_e))) == NULL)
+			return -1;
+		toks->types = types;
+		if((properties = realloc(toks->properties, size * sizeof(int))) == NULL)
+			return -1;
+		toks->properties = properties;
+		if((offsets = realloc(toks->offsets, size * sizeof(long))) == NULL)
+			return -1;
+		toks->offsets = offsets;
+		if((lengths = realloc(toks->lengths, size * sizeof(int))) == NULL)
+			return -1;
+		toks->lengths = lengths;
+		toks->size = size;
+	}
+	if(toks->text_size - toks->text_len < RENDER_BATCH_TEXT)
+	{
+		if((text = realloc(toks->text, text_size)) == NULL)
+			return -1;
+		toks->text = text;
+		toks->text_size = text_size;
+	}
+
+	return 0;
+}
+
+/* lex the file straight into the token arrays, a batch at a time */
+static int render_lex(FILE *sfp, render_tokens_t *toks)
+{
+	pevent_batch_t batch;
+	int idx;
+
+	do
+	{
+		if(render_reserve(toks) < 0)
+			return -1;
+
+		batch.types = toks->types + toks->count;
+		batch.properties = toks->properties + toks->count;
+		batch.offsets = toks->offsets + toks->count;
+		batch.lengths = toks->lengths + toks->count;
+		batch.size = toks->size - toks->count;
+		batch.text = toks->text + toks->text_len;
+		batch.text_size = toks->text_size - toks->text_len;
+		get_parser_events(sfp, &batch);
+
+		/* batch offsets are relative to the batch text */
+		for(idx = 0; idx < batch.count; idx++)
+			batch.offsets[idx] += toks->text_len;
+		toks->count += batch.count;
+		toks->text_len += batch.text_len;
+	} while(batch.types[batch.count - 1] != PEVENT_EOF);
+
+	return 0;
+}
+
+static void render_free_tokens(render_tokens_t *toks)
+{
+	free(toks->types);
+	free(toks->properties);
+	free(toks->offsets);
+	free(toks->lengths);
+	free(toks->text);
+}
+
+/* write the whole buffer at offset */
+static int render_pwrite(int fd, const char *buf, size_t len, off_t offset)
+{
+	ssize_t ret;
+
+	while(len)
+	{
+		if((ret = pwrite(fd, buf, len, offset)) < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			return -1;
+		}
+		buf += ret;
+		len -= ret;
+		offset += ret;
+	}
+
+	return 0;
+}
+
+/* pool job: html length of a chunk */
+static void render_measure_job(void *arg)
+{
+	render_chunk_t *chunk = arg;
+	render_tokens_t *toks = chunk->toks;
+	uint64_t start = trace_begin("measure chunk", NULL);
+	int idx;
+
+	chunk->length = 0;
+	for(idx = chunk->first; idx < chunk->last; idx++)
+		chunk->length += token_html_length(toks->types[idx], toks->properties[idx],
+				toks->text + toks->offsets[idx], toks->lengths[idx]);
+	trace_end("measure chunk", NULL, start);
+}
+
+/* pool job: render a chunk and write it at its place */
+static void render_write_job(void *arg)
+{
+	render_chunk_t *chunk = arg;
+	render_tokens_t *toks = chunk->toks;
+	char *buf, *p;
+	uint64_t start;
+	int idx;
+
+	if((buf = malloc(chunk->length + 1)) == NULL)
+	{
+		chunk->error = 1;
+		return;
+	}
+
+	start = trace_begin("source_to_html", NULL);
+	for(idx = chunk->first, p = buf; idx < chunk->last; idx++)
+		p = token_to_html(p, toks->types[idx], toks->properties[idx],
+				toks->text + toks->offsets[idx], toks->lengths[idx]);
+	trace_end("source_to_html", NULL, start);
+
+	start = trace_begin("flush", NULL);
+	if((size_t)(p - buf) != chunk->length || render_pwrite(chunk->fd, buf, chunk->length, chunk->offset) < 0)
+		chunk->error = 1;
+	trace_end("flush", NULL, start);
+
+	free(buf);
+}
+
+/* html of html_begin / html_end in memory */
+static char *render_tags(int begin, size_t *len)
+{
+	char *buf = NULL;
+	FILE *fp;
+
+	if((fp = open_memstream(&buf, len)) == NULL)
+		return NULL;
+	if(begin)
+		html_begin(fp, HTML_OPEN);
+	else
+		html_end(fp, HTML_CLOSE);
+	fclose(fp);
+
+	return buf;
+}
+
+/********** render functions **********/
+
+/* lex the file, then render chunks of tokens in parallel:
+ * a first pass measures the html length of every chunk, a prefix sum
+ * gives the output offset of each chunk and every job writes its chunk
+ * directly at that offset
+ */
+int render_file_parallel(const char *src_file, const char *dest_file, int num_threads, int chunk_tokens)
+{
+	render_tokens_t toks;
+	render_chunk_t *chunks = NULL;
+	pool_t *pool = NULL;
+	FILE *sfp;
+	char tmp_file[PATH_MAX] = "";
+	char *head = NULL, *foot = NULL;
+	size_t head_len = 0, foot_len = 0;
+	off_t offset;
+	uint64_t start;
+	int num_chunks, idx, fd = -1, ret = CONV_ERR_DEST;
+
+	start = trace_begin("open", src_file);
+	sfp = fopen(src_file, "r");
+	trace_end("open", src_file, start);
+	if(NULL == sfp)
+		return CONV_ERR_SOURCE;
+
+	/* lexing is serial */
+	memset(&toks, 0, sizeof(toks));
+	lang_select(src_file);
+	reset_parser();
+	start = trace_begin("get_parser_event", src_file);
+	ret = render_lex(sfp, &toks);
+	trace_end("get_parser_event", src_file, start);
+	if(ret < 0)
+	{
+		fclose(sfp);
+		render_free_tokens(&toks);
+		return CONV_ERR_SOURCE;
+	}
+	ret = CONV_ERR_DEST;
+	fclose(sfp);
+
+	if(chunk_tokens <= 0)
+		chunk_tokens = RENDER_CHUNK_TOKENS;
+	num_chunks = (toks.count + chunk_tokens - 1) / chunk_tokens;
+	head = render_tags(1, &head_len);
+	foot = render_tags(0, &foot_len);
+	chunks = calloc(num_chunks, sizeof(render_chunk_t));
+	pool = pool_create(num_threads);
+	if(!head || !foot || !chunks || !pool)
+		goto out;
+
+	/* pass 1: html length of every chunk */
+	for(idx = 0; idx < num_chunks; idx++)
+	{
+		chunks[idx].toks = &toks;
+		chunks[idx].first = idx * chunk_tokens;
+		chunks[idx].last = chunks[idx].first + chunk_tokens;
+		if(chunks[idx].last > toks.count)
+			chunks[idx].last = toks.count;
+		if(pool_submit(pool, render_measure_job, &chunks[idx]) < 0)
+			chunks[idx].error = 1;
+	}
+	pool_wait(pool);
+
+	for(idx = 0; idx < num_chunks; idx++)
+	{
+		if(chunks[idx].error)
+			goto out;
+	}
+
+	/* prefix sum gives the offset of every chunk */
+	offset = head_len;
+	for(idx = 0; idx < num_chunks; idx++)
+	{
+		chunks[idx].offset = offset;
+		offset += chunks[idx].length;
+	}
+
+	conv_tmp_name(tmp_file, sizeof(tmp_file), dest_file);
+	if((fd = open(tmp_file, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)) < 0)
+		goto out;
+	if(ftruncate(fd, offset + foot_len) < 0 ||
+			render_pwrite(fd, head, head_len, 0) < 0 ||
+			render_pwrite(fd, foot, foot_len, offset) < 0)
+		goto out;
+
+	/* pass 2: every chunk is rendered and written at its offset */
+	for(idx = 0; idx < num_chunks; idx++)
+	{
+		chunks[idx].fd = fd;
+		if(pool_submit(pool, render_write_job, &chunks[idx]) < 0)
+			chunks[idx].error = 1;
+	}
+	pool_wait(pool);
+
+	for(idx = 0; idx < num_chunks; idx++)
+	{
+		if(chunks[idx].error)
+			goto out;
+	}
+
+	start = trace_begin("close", dest_file);
+	if(close(fd) == 0 && rename(tmp_file, dest_file) == 0)
+		ret = CONV_OK;
+	trace_end("close", dest_file, start);
+	fd = -1;
+
+out:
+	if(fd >= 0)
+		close(fd);
+	if(ret != CONV_OK && tmp_file[0])
+		unlink(tmp_file);
+	if(pool)
+		pool_destroy(pool);
+	free(chunks);
+	free(head);
+	free(foot);
+	render_free_tokens(&toks);
+
+	return ret;
+}
+/**** End of file ****/
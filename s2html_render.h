@@ -0,0 +1,19 @@
+#ifndef S2HTML_RENDER_H
+#define S2HTML_RENDER_H
+
+/* constants */
+
+#define RENDER_CHUNK_TOKENS			65536 /* tokens rendered by one job */
+#define RENDER_BATCH_EVENTS			4096  /* events lexed by one get_parser_events call */
+#define RENDER_BATCH_TEXT			(RENDER_BATCH_EVENTS * 16 + PEVENT_DATA_SIZE) /* text room of one batch */
+#define RENDER_PARALLEL_MIN_SIZE	(4 * 1024 * 1024) /* smaller files are not worth the threads */
+
+/********** function prototypes **********/
+
+/* same output as convert_file, rendered by num_threads threads (<= 0 => one per CPU)
+ * in chunks of chunk_tokens tokens (<= 0 => RENDER_CHUNK_TOKENS)
+ */
+int render_file_parallel(const char *src_file, const char *dest_file, int num_threads, int chunk_tokens);
+
+#endif
+/**** End of file ****/
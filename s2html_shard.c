@@ -0,0 +1,442 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "s2html_event.h"
+#include "s2html_conv.h"
+#include "s2html_index.h"
+#include "s2html_shard.h"
+#include "s2html_trace.h"
+
+//structure to hold one file while the tree is split
+typedef struct
+{
+	long size;
+	uint64_t hash;
+	const char *path;
+	int idx;                // position in the batch list
+}shard_item_t;
+
+//structure to hold one file of a manifest
+typedef struct
+{
+	char *path;             // below the directory of the tree
+	long size;
+}shard_entry_t;
+
+/********** Utility functions **********/
+
+/* FNV-1a */
+static uint64_t shard_hash(const char *path)
+{
+	uint64_t hash = 14695981039346656037ull;
+
+	while(*path)
+	{
+		hash ^= (unsigned char)*path++;
+		hash *= 1099511628211ull;
+	}
+
+	return hash;
+}
+
+/* sort helper: biggest files first, equal sizes spread by hash */
+static int shard_cmp_item(const void *a, const void *b)
+{
+	const shard_item_t *ia = a, *ib = b;
+
+	if(ia->size != ib->size)
+		return ia->size > ib->size ? -1 : 1;
+	if(ia->hash != ib->hash)
+		return ia->hash < ib->hash ? -1 : 1;
+	return strcmp(ia->path, ib->path);
+}
+
+/* sort helper: manifest entries by path, the order of batch_collect */
+static int shard_cmp_entry(const void *a, const void *b)
+{
+	return strcmp(((const shard_entry_t *)a)->path, ((const shard_entry_t *)b)->path);
+}
+
+/* heap order of shards: least loaded first, lowest number on a tie */
+static int shard_less(const long long *loads, int a, int b)
+{
+	return loads[a] < loads[b] || (loads[a] == loads[b] && a < b);
+}
+
+/* restore the heap after the load of its top grew */
+static void shard_sift(int *heap, int count, const long long *loads)
+{
+	int pos = 0, child, tmp;
+
+	while((child = 2 * pos + 1) < count)
+	{
+		if(child + 1 < count && shard_less(loads, heap[child + 1], heap[child]))
+			child++;
+		if(!shard_less(loads, heap[child], heap[pos]))
+			break;
+		tmp = heap[pos];
+		heap[pos] = heap[child];
+		heap[child] = tmp;
+		pos = child;
+	}
+}
+
+/* write text with the characters html gives a meaning escaped */
+static void shard_put_escaped(FILE *fp, const char *text)
+{
+	for(; *text; text++)
+	{
+		switch(*text)
+		{
+			case '<': fputs("&lt;", fp); break;
+			case '>': fputs("&gt;", fp); break;
+			case '&': fputs("&amp;", fp); break;
+			case '"': fputs("&quot;", fp); break;
+			default: fputc(*text, fp);
+		}
+	}
+}
+
+/* page linking the html of every file, files without one are marked failed */
+static int shard_write_page(const char *dir, const shard_entry_t *entries, int count, const io_stats_t *stats)
+{
+	char page_file[PATH_MAX], tmp_file[PATH_MAX], html_file[PATH_MAX];
+	const char *name;
+	struct stat st;
+	FILE *fp;
+	int idx;
+
+	snprintf(page_file, sizeof(page_file), "%s/%s", dir, SHARD_PAGE_NAME);
+	conv_tmp_name(tmp_file, sizeof(tmp_file), page_file);
+	if((fp = fopen(tmp_file, "w")) == NULL)
+		return -1;
+
+	fprintf(fp, "<!DOCTYPE html>\n<html lang=\"en-US\">\n<head>\n<meta charset=\"utf-8\">\n<title>");
+	shard_put_escaped(fp, dir);
+	fprintf(fp, "</title>\n<style>\nbody { font-family: monospace; }\ntd { padding: 0 1em; }\n"
+			"td.size { text-align: right; }\n.failed { color: #c00; }\n</style>\n</head>\n<body>\n<h1>");
+	shard_put_escaped(fp, dir);
+	fprintf(fp, "</h1>\n<p>%ld files (%ld failed), %.1f KB -> %.1f KB</p>\n<table>\n",
+			stats->files, stats->failed, stats->bytes_in / 1024.0, stats->bytes_out / 1024.0);
+
+	for(idx = 0; idx < count; idx++)
+	{
+		/* links are relative to the page, like the paths of the manifests */
+		name = entries[idx].path;
+		snprintf(html_file, sizeof(html_file), "%s/%s.html", dir, name);
+		if(stat(html_file, &st) == 0)
+		{
+			fprintf(fp, "<tr><td><a href=\"");
+			shard_put_escaped(fp, name);
+			fprintf(fp, ".html\">");
+			shard_put_escaped(fp, name);
+			fprintf(fp, "</a></td><td class=\"size\">%ld</td></tr>\n", entries[idx].size);
+		}
+		else
+		{
+			fprintf(fp, "<tr class=\"failed\"><td>");
+			shard_put_escaped(fp, name);
+			fprintf(fp, "</td><td class=\"size\">%ld</td></tr>\n", entries[idx].size);
+		}
+	}
+	fprintf(fp, "</table>\n</body>\n</html>\n");
+
+	if(fclose(fp) != 0 || rename(tmp_file, page_file) != 0)
+	{
+		unlink(tmp_file);
+		return -1;
+	}
+	printf("Index page %s generated\n", page_file);
+
+	return 0;
+}
+
+/* add the files of a manifest to entries and its counters to stats, -1 if it can not be read */
+static int shard_read_manifest(const char *manifest, int shard, int shards,
+		shard_entry_t **entries, int *count, io_stats_t *stats)
+{
+	char line[PATH_MAX + 64];
+	shard_entry_t *grown;
+	io_stats_t part;
+	char *path;
+	FILE *fp;
+	int got_shard, got_shards, size = *count;
+
+	if((fp = fopen(manifest, "r")) == NULL)
+		return -1;
+	if(fgets(line, sizeof(line), fp) == NULL ||
+			sscanf(line, "s2html shard %d/%d %ld %ld %ld %ld %lf", &got_shard, &got_shards,
+				&part.files, &part.failed, &part.bytes_in, &part.bytes_out, &part.msec) != 7 ||
+			got_shard != shard || got_shards != shards)
+	{
+		fclose(fp);
+		return -1;
+	}
+
+	/* one "<size>\t<path>" line per file */
+	while(fgets(line, sizeof(line), fp))
+	{
+		line[strcspn(line, "\n")] = '\0';
+		if((path = strchr(line, '\t')) == NULL)
+			continue;
+		if(*count == size)
+		{
+			size = size ? size * 2 : 256;
+			if((grown = realloc(*entries, size * sizeof(shard_entry_t))) == NULL)
+			{
+				fclose(fp);
+				return -1;
+			}
+			*entries = grown;
+		}
+		(*entries)[*count].size = atol(line);
+		(*entries)[*count].path = strdup(path + 1);
+		(*count)++;
+	}
+	fclose(fp);
+
+	stats->files += part.files;
+	stats->failed += part.failed;
+	stats->bytes_in += part.bytes_in;
+	stats->bytes_out += part.bytes_out;
+	if(part.msec > stats->msec)
+		stats->msec = part.msec;
+
+	return 0;
+}
+
+/* every source file of the tree must be in exactly one manifest, returns the mismatches */
+static int shard_check_tree(const char *dir, const shard_entry_t *entries, int count)
+{
+	batch_list_t list;
+	int idx = 0, jdx = 0, cmp, bad = 0;
+
+	if(batch_collect(dir, &list) < 0)
+	{
+		printf("Error! could not read directory %s\n", dir);
+		batch_free(&list);
+		return 1;
+	}
+
+	while(idx < list.count || jdx < count)
+	{
+		if(idx == list.count)
+			cmp = 1;
+		else if(jdx == count)
+			cmp = -1;
+		else
+			cmp = strcmp(batch_rel_path(dir, list.files[idx]), entries[jdx].path);
+
+		if(cmp < 0)
+		{
+			printf("Error! %s is in no shard\n", list.files[idx++]);
+			bad++;
+		}
+		else if(cmp > 0)
+		{
+			printf("Error! %s/%s is not in the tree anymore\n", dir, entries[jdx++].path);
+			bad++;
+		}
+		else
+		{
+			idx++;
+			jdx++;
+			/* the manifests are sorted, so a file of two shards shows up twice in a row */
+			while(jdx < count && strcmp(entries[jdx].path, entries[jdx - 1].path) == 0)
+			{
+				printf("Error! %s/%s is in more than one shard\n", dir, entries[jdx++].path);
+				bad++;
+			}
+		}
+	}
+
+	batch_free(&list);
+
+	return bad;
+}
+
+/********** shard functions **********/
+
+int shard_parse(const char *arg, int *shard, int *shards)
+{
+	char *end;
+
+	*shard = strtol(arg, &end, 10);
+	if(end == arg || *end != '/')
+		return -1;
+	arg = end + 1;
+	*shards = strtol(arg, &end, 10);
+	if(end == arg || *end != '\0')
+		return -1;
+
+	return *shards > 0 && *shards <= SHARD_MAX && *shard >= 0 && *shard < *shards ? 0 : -1;
+}
+
+void shard_file(char *file, size_t size, const char *dir, int shard, int shards, const char *ext)
+{
+	snprintf(file, size, "%s/s2html.shard%dof%d.%s", dir, shard, shards, ext);
+}
+
+/* longest processing time first: the biggest file not placed yet goes to
+ * the least loaded shard, equal sizes are ordered by the hash of the path
+ * below dir so the files of one directory spread over the shards
+ */
+void shard_select(const char *dir, batch_list_t *list, int shard, int shards)
+{
+	shard_item_t *items = malloc((list->count + 1) * sizeof(shard_item_t));
+	long long *loads = calloc(shards, sizeof(long long));
+	int *heap = malloc(shards * sizeof(int));
+	char *keep = calloc(list->count + 1, 1);
+	int idx, kept = 0;
+
+	if(items == NULL || loads == NULL || heap == NULL || keep == NULL)
+	{
+		/* without memory no shard can be picked, so this one takes nothing */
+		for(idx = 0; idx < list->count; idx++)
+			free(list->files[idx]);
+		list->count = 0;
+		goto done;
+	}
+
+	for(idx = 0; idx < list->count; idx++)
+	{
+		items[idx].size = list->sizes[idx];
+		items[idx].path = batch_rel_path(dir, list->files[idx]);
+		items[idx].hash = shard_hash(items[idx].path);
+		items[idx].idx = idx;
+	}
+	qsort(items, list->count, sizeof(shard_item_t), shard_cmp_item);
+
+	for(idx = 0; idx < shards; idx++)
+		heap[idx] = idx;
+	for(idx = 0; idx < list->count; idx++)
+	{
+		if(heap[0] == shard)
+			keep[items[idx].idx] = 1;
+		loads[heap[0]] += items[idx].size + SHARD_FILE_COST;
+		shard_sift(heap, shards, loads);
+	}
+
+	/* the kept files stay in path order */
+	for(idx = 0; idx < list->count; idx++)
+	{
+		if(keep[idx])
+		{
+			list->files[kept] = list->files[idx];
+			list->sizes[kept] = list->sizes[idx];
+			kept++;
+		}
+		else
+			free(list->files[idx]);
+	}
+	list->count = kept;
+
+done:
+	free(items);
+	free(loads);
+	free(heap);
+	free(keep);
+}
+
+int shard_write_manifest(const char *dir, int shard, int shards, const batch_list_t *list, const io_stats_t *stats)
+{
+	char manifest[PATH_MAX], tmp_file[PATH_MAX];
+	FILE *fp;
+	int idx;
+
+	shard_file(manifest, sizeof(manifest), dir, shard, shards, "manifest");
+	conv_tmp_name(tmp_file, sizeof(tmp_file), manifest);
+	if((fp = fopen(tmp_file, "w")) == NULL)
+		return -1;
+
+	fprintf(fp, "s2html shard %d/%d %ld %ld %ld %ld %.3f\n", shard, shards,
+			stats->files, stats->failed, stats->bytes_in, stats->bytes_out, stats->msec);
+	for(idx = 0; idx < list->count; idx++)
+		fprintf(fp, "%ld\t%s\n", list->sizes[idx], batch_rel_path(dir, list->files[idx]));
+
+	if(fclose(fp) != 0 || rename(tmp_file, manifest) != 0)
+	{
+		unlink(tmp_file);
+		return -1;
+	}
+
+	return 0;
+}
+
+int shard_merge(const char *dir, int shards)
+{
+	char file[PATH_MAX], index_file[PATH_MAX];
+	char **parts = NULL;
+	shard_entry_t *entries = NULL;
+	io_stats_t stats = {0, 0, 0, 0, 0};
+	struct stat st;
+	uint64_t start;
+	int shard, count = 0, ret = 0, merged;
+
+	for(shard = 0; shard < shards; shard++)
+	{
+		shard_file(file, sizeof(file), dir, shard, shards, "manifest");
+		if(shard_read_manifest(file, shard, shards, &entries, &count, &stats) < 0)
+		{
+			printf("Error! shard %d/%d is not done, could not read %s\n", shard, shards, file);
+			ret = 2;
+		}
+	}
+	if(ret)
+		goto done;
+
+	qsort(entries, count, sizeof(shard_entry_t), shard_cmp_entry);
+	if(shard_check_tree(dir, entries, count))
+		ret = 3;
+
+	printf("Merged %d shards: %ld files (%ld failed), %.1f KB -> %.1f KB, slowest shard %.1f ms\n",
+			shards, stats.files, stats.failed, stats.bytes_in / 1024.0, stats.bytes_out / 1024.0, stats.msec);
+	if(stats.failed)
+		ret = 3;
+
+	if(shard_write_page(dir, entries, count, &stats) < 0)
+	{
+		printf("Error! could not create %s/%s index page\n", dir, SHARD_PAGE_NAME);
+		ret = 3;
+	}
+
+	/* the shards were run with --index when the first one has a partial index */
+	shard_file(file, sizeof(file), dir, 0, shards, "idx");
+	if(stat(file, &st) == 0)
+	{
+		if((parts = calloc(shards, sizeof(char *))) == NULL)
+		{
+			ret = 4;
+			goto done;
+		}
+		for(shard = 0; shard < shards; shard++)
+		{
+			shard_file(file, sizeof(file), dir, shard, shards, "idx");
+			parts[shard] = strdup(file);
+		}
+		snprintf(index_file, sizeof(index_file), "%s/%s", dir, INDEX_FILE_NAME);
+		start = trace_begin("index merge", index_file);
+		merged = index_merge(parts, shards, index_file);
+		trace_end("index merge", index_file, start);
+		if(merged < 0)
+			ret = 3;
+		else
+			printf("Index file %s generated\n", index_file);
+		for(shard = 0; shard < shards; shard++)
+			free(parts[shard]);
+		free(parts);
+	}
+
+done:
+	for(shard = 0; shard < count; shard++)
+		free(entries[shard].path);
+	free(entries);
+
+	return ret;
+}
+/**** End of file ****/
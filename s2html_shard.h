@@ -0,0 +1,34 @@
+#ifndef S2HTML_SHARD_H
+#define S2HTML_SHARD_H
+
+#include <stddef.h>
+#include "s2html_batch.h"
+#include "s2html_io.h"
+
+/* constants */
+
+#define SHARD_MAX			4096 /* shards of one tree */
+#define SHARD_FILE_COST		4096 /* opening, writing and renaming a file costs about this many source bytes */
+#define SHARD_PAGE_NAME		"index.html" /* list of the converted files, written by the merge */
+
+/* partial outputs of shard i of N are <dir>/s2html.shard<i>of<N>.manifest and,
+ * with --index, <dir>/s2html.shard<i>of<N>.idx, the manifest is written last
+ * so that it only exists once the shard is done. Files are hashed and
+ * recorded by their path below <dir>, so shards may spell <dir> differently
+ */
+
+/********** function prototypes **********/
+
+int shard_parse(const char *arg, int *shard, int *shards); /* "i/N", -1 if malformed */
+void shard_file(char *file, size_t size, const char *dir, int shard, int shards, const char *ext);
+
+/* keep the files of shard out of shards, every process computes the same split */
+void shard_select(const char *dir, batch_list_t *list, int shard, int shards);
+
+int shard_write_manifest(const char *dir, int shard, int shards, const batch_list_t *list, const io_stats_t *stats);
+
+/* combine the outputs of all shards of dir: stats, index page and search index, returns exit code */
+int shard_merge(const char *dir, int shards);
+
+#endif
+/**** End of file ****/
@@ -0,0 +1,198 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#ifdef S2HTML_USDT
+#include <sys/sdt.h>
+#endif
+#include "s2html_trace.h"
+
+/* USDT probes cost a nop until perf or bpftrace attaches to them */
+#ifdef S2HTML_USDT
+#define TRACE_PROBE(probe, name, arg)	DTRACE_PROBE2(s2html, probe, name, arg)
+#else
+#define TRACE_PROBE(probe, name, arg)	((void)(name), (void)(arg))
+#endif
+
+//structure to hold the phases of one thread
+typedef struct trace_ring
+{
+	uint64_t head;              // phases ever written, only the owner thread writes
+	long tid;
+	struct trace_ring *next;    // list of all rings
+	trace_event_t events[TRACE_RING_EVENTS];
+}trace_ring_t;
+
+/********** global variables **********/
+
+int trace_enabled = 0;
+
+static const char *trace_file_name;
+static trace_ring_t *trace_rings;           // pushed with compare and swap
+static __thread trace_ring_t *trace_ring;   // ring of this thread
+
+/********** Utility functions **********/
+
+uint64_t trace_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/* ring of the calling thread, created on its first phase */
+static trace_ring_t *trace_thread_ring(void)
+{
+	trace_ring_t *ring;
+
+	if(trace_ring)
+		return trace_ring;
+
+	if((ring = calloc(1, sizeof(trace_ring_t))) == NULL)
+		return NULL;
+	ring->tid = syscall(SYS_gettid);
+
+	ring->next = __atomic_load_n(&trace_rings, __ATOMIC_RELAXED);
+	while(!__atomic_compare_exchange_n(&trace_rings, &ring->next, ring, 1,
+				__ATOMIC_RELEASE, __ATOMIC_RELAXED))
+		;
+
+	return trace_ring = ring;
+}
+
+/* json string, file names may hold any byte */
+static void trace_put_string(FILE *fp, const char *str)
+{
+	const unsigned char *p;
+
+	fputc('"', fp);
+	for(p = (const unsigned char *)str; *p; p++)
+	{
+		if(*p == '"' || *p == '\\')
+			fprintf(fp, "\\%c", *p);
+		else if(*p < 0x20)
+			fprintf(fp, "\\u%04x", *p);
+		else
+			fputc(*p, fp);
+	}
+	fputc('"', fp);
+}
+
+/* write the phases of all threads as chrome trace events */
+static void trace_write(void)
+{
+	trace_ring_t *ring;
+	trace_event_t *ev;
+	uint64_t head, idx;
+	FILE *fp;
+	int pid = getpid(), first = 1, sum;
+
+	if((fp = fopen(trace_file_name, "w")) == NULL)
+	{
+		printf("Error! could not create %s trace file\n", trace_file_name);
+		return;
+	}
+
+	fprintf(fp, "{\"traceEvents\":[\n");
+	for(ring = __atomic_load_n(&trace_rings, __ATOMIC_ACQUIRE); ring; ring = ring->next)
+	{
+		fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%ld,"
+				"\"args\":{\"name\":\"%s\"}}", first ? "" : ",\n", pid, ring->tid,
+				ring->tid == pid ? "main" : "worker");
+		first = 0;
+
+		/* the oldest phases were overwritten when the ring wrapped */
+		head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+		for(idx = head > TRACE_RING_EVENTS ? head - TRACE_RING_EVENTS : 0; idx < head; idx++)
+		{
+			ev = &ring->events[idx & (TRACE_RING_EVENTS - 1)];
+			fprintf(fp, ",\n{\"name\":\"%s\",\"cat\":\"s2html\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+					"\"pid\":%d,\"tid\":%ld", ev->name, ev->start / 1000.0, ev->dur / 1000.0,
+					pid, ring->tid);
+			if(ev->arg[0] || ev->sum_names[0])
+			{
+				fprintf(fp, ",\"args\":{");
+				if(ev->arg[0])
+				{
+					fprintf(fp, "\"file\":");
+					trace_put_string(fp, ev->arg);
+				}
+				for(sum = 0; sum < TRACE_SUMS && ev->sum_names[sum]; sum++)
+					fprintf(fp, "%s\"%s_ms\":%.3f", (ev->arg[0] || sum) ? "," : "",
+							ev->sum_names[sum], ev->sums[sum] / 1000000.0);
+				fputc('}', fp);
+			}
+			fputc('}', fp);
+		}
+	}
+	fprintf(fp, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+	if(fclose(fp) != 0)
+		printf("Error! could not write %s trace file\n", trace_file_name);
+}
+
+/********** trace functions **********/
+
+int trace_open(const char *trace_file)
+{
+	trace_file_name = trace_file;
+	if(atexit(trace_write) != 0)
+		return -1;
+	trace_enabled = 1;
+
+	return 0;
+}
+
+uint64_t trace_begin(const char *name, const char *arg)
+{
+	TRACE_PROBE(phase__begin, name, arg);
+
+	return trace_enabled ? trace_now() : 0;
+}
+
+void trace_end(const char *name, const char *arg, uint64_t start)
+{
+	trace_end_sums(name, arg, start, NULL, NULL, 0);
+}
+
+void trace_end_sums(const char *name, const char *arg, uint64_t start,
+		const char *const sum_names[], const uint64_t sums[], int count)
+{
+	trace_ring_t *ring;
+	trace_event_t *ev;
+	size_t len;
+	int idx;
+
+	TRACE_PROBE(phase__end, name, arg);
+
+	if(!trace_enabled || !start || (ring = trace_thread_ring()) == NULL)
+		return;
+
+	ev = &ring->events[ring->head & (TRACE_RING_EVENTS - 1)];
+	ev->name = name;
+	ev->start = start;
+	ev->dur = trace_now() - start;
+	for(idx = 0; idx < TRACE_SUMS; idx++)
+	{
+		ev->sum_names[idx] = idx < count ? sum_names[idx] : NULL;
+		ev->sums[idx] = idx < count ? sums[idx] : 0;
+	}
+	ev->arg[0] = '\0';
+	if(arg)
+	{
+		/* the end of a path tells more than its beginning */
+		len = strlen(arg);
+		if(len >= TRACE_ARG_SIZE)
+			arg += len - (TRACE_ARG_SIZE - 1);
+		strcpy(ev->arg, arg);
+	}
+
+	/* publish the phase, the ring is read at exit */
+	__atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+}
+/**** End of file ****/
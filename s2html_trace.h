@@ -0,0 +1,44 @@
+#ifndef S2HTML_TRACE_H
+#define S2HTML_TRACE_H
+
+#include <stdint.h>
+
+/* constants */
+
+#define TRACE_RING_EVENTS	16384 /* phases kept per thread, power of 2, older ones are overwritten */
+#define TRACE_ARG_SIZE		64    /* tail of the file name kept with a phase */
+#define TRACE_SUMS			2     /* kinds of steps timed inside one phase */
+
+//structure to hold one finished phase
+typedef struct
+{
+	const char *name;           // phase name, a string literal
+	uint64_t start;             // CLOCK_MONOTONIC ns
+	uint64_t dur;               // ns
+	const char *sum_names[TRACE_SUMS]; // steps summed inside the phase, NULL when unused
+	uint64_t sums[TRACE_SUMS];  // ns spent in every kind of step
+	char arg[TRACE_ARG_SIZE];   // file of the phase, may be empty
+}trace_event_t;
+
+/* tracing is off until trace_open is called */
+extern int trace_enabled;
+
+/********** function prototypes **********/
+
+int trace_open(const char *trace_file); /* record phases, json is written to trace_file at exit */
+
+/* a phase runs from trace_begin to trace_end, arg (a file name) may be NULL
+ * trace_begin returns the start time, 0 when tracing is off
+ */
+uint64_t trace_begin(const char *name, const char *arg);
+void trace_end(const char *name, const char *arg, uint64_t start);
+
+/* trace_end of a phase made of steps too short and too many to record one
+ * by one, the time of up to TRACE_SUMS kinds of them is kept as its args
+ */
+void trace_end_sums(const char *name, const char *arg, uint64_t start,
+		const char *const sum_names[], const uint64_t sums[], int count);
+uint64_t trace_now(void); /* CLOCK_MONOTONIC ns */
+
+#endif
+/**** End of file ****/
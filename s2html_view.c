@@ -0,0 +1,364 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include "s2html_event.h"
+#include "s2html_conv.h"
+#include "s2html_lang.h"
+#include "s2html_view.h"
+
+#define VIEW_BATCH_EVENTS	1024
+#define NUM_VIEW_CLASSES	(int)(sizeof(view_classes) / sizeof(view_classes[0]))
+
+/* css classes of styles.css, the token class codes index this table */
+static const char *view_classes[] =
+{
+	"", "preprocess_dir", "comment", "string", "header_file",
+	"numeric_constant", "reserved_key1", "reserved_key2", "ascii_char"
+};
+
+//structure to hold the source text and its tokens line by line
+typedef struct
+{
+	char *text;         // source text as shown
+	long text_len;
+	long text_size;
+	int *line_len;      // bytes of every line, without '\n'
+	long line_len_size;
+	int *line_toks;     // tokens of every line
+	long line_toks_size;
+	long lines;
+	int *toks;          // column, length and class code of every token
+	long tok_count;
+	long toks_size;
+	long line_start;    // text offset of the current line
+	int line_tok_count; // tokens of the current line
+}view_page_t;
+
+/* the viewer: it keeps only the visible lines (and some overscan) in the DOM */
+static const char view_script[] =
+"(function () {\n"
+"	var meta = JSON.parse(document.getElementById(\"s2h_tokens\").textContent);\n"
+"	var bin = atob(document.getElementById(\"s2h_source\").textContent);\n"
+"	var src = new Uint8Array(bin.length), dec = new TextDecoder(\"utf-8\");\n"
+"	var n = meta.line_len.length, i;\n"
+"	var lineStart = new Float64Array(n + 1), tokStart = new Int32Array(n + 1);\n"
+"	var view = document.getElementById(\"s2h_view\"), pre = document.getElementById(\"s2h_lines\");\n"
+"	var lh, height, scale, first = -1, last = -1, queued = false;\n"
+"\n"
+"	for (i = 0; i < bin.length; i++)\n"
+"		src[i] = bin.charCodeAt(i);\n"
+"	for (i = 0; i < n; i++) {\n"
+"		lineStart[i + 1] = lineStart[i] + meta.line_len[i] + 1;\n"
+"		tokStart[i + 1] = tokStart[i] + meta.line_toks[i];\n"
+"	}\n"
+"\n"
+"	function text(a, b) {\n"
+"		return dec.decode(src.subarray(a, b));\n"
+"	}\n"
+"\n"
+"	function line(frag, i) {\n"
+"		var s = lineStart[i], col = 0, t, c, l, span;\n"
+"		for (t = tokStart[i]; t < tokStart[i + 1]; t++) {\n"
+"			c = meta.toks[3 * t];\n"
+"			l = meta.toks[3 * t + 1];\n"
+"			if (c > col)\n"
+"				frag.appendChild(document.createTextNode(text(s + col, s + c)));\n"
+"			span = document.createElement(\"span\");\n"
+"			span.className = meta.classes[meta.toks[3 * t + 2]];\n"
+"			span.textContent = text(s + c, s + c + l);\n"
+"			frag.appendChild(span);\n"
+"			col = c + l;\n"
+"		}\n"
+"		frag.appendChild(document.createTextNode(text(s + col, s + meta.line_len[i]) + \"\\n\"));\n"
+"	}\n"
+"\n"
+"	/* the view is as high as all lines, up to the height browsers allow:\n"
+"	 * past it scrolling the view scrolls the lines scale times faster\n"
+"	 */\n"
+"	function layout() {\n"
+"		var full = n * lh, vh = window.innerHeight;\n"
+"		height = Math.min(full, %d);\n"
+"		scale = (full > height && height > vh) ? (full - vh) / (height - vh) : 1;\n"
+"		view.style.height = height + \"px\";\n"
+"	}\n"
+"\n"
+"	function draw() {\n"
+"		var top = window.scrollY - view.offsetTop, vtop, frag, a, b;\n"
+"		queued = false;\n"
+"		vtop = top > 0 ? top * scale : top; /* top of the window in the lines */\n"
+"		a = Math.max(0, Math.floor(vtop / lh));\n"
+"		b = Math.min(n, Math.ceil((vtop + window.innerHeight) / lh));\n"
+"		if (a < first || b > last) {\n"
+"			a = Math.max(0, a - %d);\n"
+"			b = Math.min(n, b + %d);\n"
+"			frag = document.createDocumentFragment();\n"
+"			for (i = a; i < b; i++)\n"
+"				line(frag, i);\n"
+"			pre.textContent = \"\";\n"
+"			pre.appendChild(frag);\n"
+"			first = a;\n"
+"			last = b;\n"
+"		}\n"
+"		/* the built lines follow the window when the view is scaled */\n"
+"		pre.style.top = (first * lh - vtop + top) + \"px\";\n"
+"	}\n"
+"\n"
+"	/* height of one line */\n"
+"	pre.textContent = \"x\";\n"
+"	lh = pre.getBoundingClientRect().height || 16;\n"
+"	layout();\n"
+"	draw();\n"
+"	window.addEventListener(\"scroll\", function () {\n"
+"		if (!queued) {\n"
+"			queued = true;\n"
+"			window.requestAnimationFrame(draw);\n"
+"		}\n"
+"	});\n"
+"	window.addEventListener(\"resize\", function () {\n"
+"		layout();\n"
+"		first = last = -1;\n"
+"		draw();\n"
+"	});\n"
+"})();\n";
+
+/********** Utility functions **********/
+
+/* grow an array of int to hold entries more */
+static int view_grow(int **array, long count, long *size, int entries)
+{
+	if(count + entries <= *size)
+		return 0;
+	*size = *size ? *size * 2 : 4096;
+	while(count + entries > *size)
+		*size *= 2;
+	if((*array = realloc(*array, *size * sizeof(int))) == NULL)
+		return -1;
+
+	return 0;
+}
+
+/* class code of an event, 0 for plain text */
+static int view_class_code(pevent_e type, int property)
+{
+	const char *cls = type_class(type, property);
+	int idx;
+
+	if(cls == NULL)
+		return 0;
+	for(idx = 1; idx < NUM_VIEW_CLASSES; idx++)
+	{
+		if(strcmp(cls, view_classes[idx]) == 0)
+			return idx;
+	}
+
+	return 0;
+}
+
+static int view_add_token(view_page_t *page, long start, long end, int cls)
+{
+	if(end <= start)
+		return 0;
+	if(view_grow(&page->toks, page->tok_count * 3, &page->toks_size, 3) < 0)
+		return -1;
+	page->toks[page->tok_count * 3] = start - page->line_start;
+	page->toks[page->tok_count * 3 + 1] = end - start;
+	page->toks[page->tok_count * 3 + 2] = cls;
+	page->tok_count++;
+	page->line_tok_count++;
+
+	return 0;
+}
+
+/* close the line ending at text offset end */
+static int view_end_line(view_page_t *page, long end)
+{
+	if(view_grow(&page->line_len, page->lines, &page->line_len_size, 1) < 0 ||
+			view_grow(&page->line_toks, page->lines, &page->line_toks_size, 1) < 0)
+		return -1;
+	page->line_len[page->lines] = end - page->line_start;
+	page->line_toks[page->lines] = page->line_tok_count;
+	page->lines++;
+	page->line_start = end + 1;
+	page->line_tok_count = 0;
+
+	return 0;
+}
+
+/* append the text of one event, tokens are split at line ends */
+static int view_add_event(view_page_t *page, pevent_e type, int property, const char *data, int length)
+{
+	int std_header = (type == PEVENT_HEADER_FILE && property != USER_HEADER_FILE);
+	int cls = view_class_code(type, property);
+	long pos, seg_start;
+
+	if(page->text_len + length + 2 > page->text_size)
+	{
+		page->text_size = page->text_size ? page->text_size * 2 : 1024 * 1024;
+		while(page->text_len + length + 2 > page->text_size)
+			page->text_size *= 2;
+		if((page->text = realloc(page->text, page->text_size)) == NULL)
+			return -1;
+	}
+
+	/* the lexer drops the brackets of a standard header */
+	seg_start = pos = page->text_len;
+	if(std_header)
+		page->text[page->text_len++] = '<';
+	memcpy(page->text + page->text_len, data, length);
+	page->text_len += length;
+	if(std_header)
+		page->text[page->text_len++] = '>';
+
+	for(; pos < page->text_len; pos++)
+	{
+		if(page->text[pos] != '\n')
+			continue;
+		if((cls && view_add_token(page, seg_start, pos, cls) < 0) || view_end_line(page, pos) < 0)
+			return -1;
+		seg_start = pos + 1;
+	}
+	if(cls && view_add_token(page, seg_start, page->text_len, cls) < 0)
+		return -1;
+
+	return 0;
+}
+
+static void view_put_ints(FILE *fp, const char *name, const int *array, long count)
+{
+	long idx;
+
+	fprintf(fp, "\"%s\":[", name);
+	for(idx = 0; idx < count; idx++)
+		fprintf(fp, idx ? ",%d" : "%d", array[idx]);
+	fprintf(fp, "]");
+}
+
+static void view_put_base64(FILE *fp, const unsigned char *data, long len)
+{
+	static const char digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	unsigned long bits;
+	long idx;
+
+	for(idx = 0; idx + 2 < len; idx += 3)
+	{
+		bits = (unsigned long)data[idx] << 16 | data[idx + 1] << 8 | data[idx + 2];
+		fputc(digits[bits >> 18], fp);
+		fputc(digits[(bits >> 12) & 63], fp);
+		fputc(digits[(bits >> 6) & 63], fp);
+		fputc(digits[bits & 63], fp);
+	}
+	if(idx < len)
+	{
+		bits = (unsigned long)data[idx] << 16 | (idx + 1 < len ? data[idx + 1] << 8 : 0);
+		fputc(digits[bits >> 18], fp);
+		fputc(digits[(bits >> 12) & 63], fp);
+		fputc(idx + 1 < len ? digits[(bits >> 6) & 63] : '=', fp);
+		fputc('=', fp);
+	}
+}
+
+/* the page: source, tokens and the viewer script */
+static void view_write(FILE *fp, const view_page_t *page)
+{
+	int idx;
+
+	fprintf(fp, "<!DOCTYPE html>\n");
+	fprintf(fp, "<html lang=\"en-US\">\n");
+	fprintf(fp, "<head>\n");
+	fprintf(fp, "<title>%s</title>\n", "sode2html");
+	fprintf(fp, "<meta charset=\"UTF-8\">\n");
+	fprintf(fp, "<link rel=\"stylesheet\" href=\"styles.css\">\n");
+	fprintf(fp, "<style>#s2h_view{position:relative;}#s2h_lines{position:absolute;left:0;right:0;margin:0;}</style>\n");
+	fprintf(fp, "</head>\n");
+	fprintf(fp, "<body style=\"background-color:lightgrey;\">\n");
+	fprintf(fp, "<div id=\"s2h_view\"><pre id=\"s2h_lines\"></pre></div>\n");
+
+	fprintf(fp, "<script type=\"application/json\" id=\"s2h_tokens\">{\"classes\":[");
+	for(idx = 0; idx < NUM_VIEW_CLASSES; idx++)
+		fprintf(fp, idx ? ",\"%s\"" : "\"%s\"", view_classes[idx]);
+	fprintf(fp, "],\n");
+	view_put_ints(fp, "line_len", page->line_len, page->lines);
+	fprintf(fp, ",\n");
+	view_put_ints(fp, "line_toks", page->line_toks, page->lines);
+	fprintf(fp, ",\n");
+	view_put_ints(fp, "toks", page->toks, page->tok_count * 3);
+	fprintf(fp, "}</script>\n");
+
+	fprintf(fp, "<script type=\"text/plain\" id=\"s2h_source\">");
+	view_put_base64(fp, (const unsigned char *)page->text, page->text_len);
+	fprintf(fp, "</script>\n");
+
+	fprintf(fp, "<script>\n");
+	fprintf(fp, view_script, VIEW_MAX_HEIGHT, VIEW_OVERSCAN_LINES, VIEW_OVERSCAN_LINES);
+	fprintf(fp, "</script>\n");
+	fprintf(fp, "</body>\n");
+	fprintf(fp, "</html>\n");
+}
+
+static void view_free(view_page_t *page)
+{
+	free(page->text);
+	free(page->line_len);
+	free(page->line_toks);
+	free(page->toks);
+}
+
+/********** view functions **********/
+
+int view_file(const char *src_file, const char *dest_file)
+{
+	pevent_e types[VIEW_BATCH_EVENTS];
+	int properties[VIEW_BATCH_EVENTS];
+	long offsets[VIEW_BATCH_EVENTS];
+	int lengths[VIEW_BATCH_EVENTS];
+	char text[VIEW_BATCH_EVENTS * 16 + PEVENT_DATA_SIZE];
+	pevent_batch_t batch = {types, properties, offsets, lengths, VIEW_BATCH_EVENTS, text, sizeof(text), 0, 0};
+	view_page_t page;
+	char tmp_file[PATH_MAX];
+	FILE *sfp, *dfp;
+	int idx, ret = CONV_OK;
+
+	if(NULL == (sfp = fopen(src_file, "r")))
+		return CONV_ERR_SOURCE;
+
+	memset(&page, 0, sizeof(page));
+	lang_select(src_file);
+	reset_parser();
+	do
+	{
+		get_parser_events(sfp, &batch);
+		for(idx = 0; idx < batch.count && ret == CONV_OK; idx++)
+		{
+			if(view_add_event(&page, types[idx], properties[idx], text + offsets[idx], lengths[idx]) < 0)
+				ret = CONV_ERR_SOURCE;
+		}
+	} while (ret == CONV_OK && types[batch.count - 1] != PEVENT_EOF);
+	fclose(sfp);
+
+	/* last line without '\n' */
+	if(ret == CONV_OK && page.text_len > page.line_start && view_end_line(&page, page.text_len) < 0)
+		ret = CONV_ERR_SOURCE;
+
+	if(ret == CONV_OK)
+	{
+		conv_tmp_name(tmp_file, sizeof(tmp_file), dest_file);
+		if(NULL == (dfp = fopen(tmp_file, "w")))
+			ret = CONV_ERR_DEST;
+		else
+		{
+			view_write(dfp, &page);
+			if(fclose(dfp) != 0 || rename(tmp_file, dest_file) != 0)
+			{
+				unlink(tmp_file);
+				ret = CONV_ERR_DEST;
+			}
+		}
+	}
+
+	view_free(&page);
+
+	return ret;
+}
+/**** End of file ****/
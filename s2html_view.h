@@ -0,0 +1,17 @@
+#ifndef S2HTML_VIEW_H
+#define S2HTML_VIEW_H
+
+/* constants */
+
+#define VIEW_OVERSCAN_LINES	50 /* lines built above and below the visible ones */
+#define VIEW_MAX_HEIGHT		10000000 /* px, browsers cap elements at 17 to 33 million px */
+
+/********** function prototypes **********/
+
+/* write a page holding the source and its tokens per line, a small script
+ * creates the DOM of the visible lines only, so big files open fast
+ */
+int view_file(const char *src_file, const char *dest_file);
+
+#endif
+/**** End of file ****/
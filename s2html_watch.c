@@ -0,0 +1,338 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <ftw.h>
+#include <sys/inotify.h>
+#include "s2html_event.h"
+#include "s2html_conv.h"
+#include "s2html_lang.h"
+#include "s2html_pool.h"
+#include "s2html_watch.h"
+
+#define WATCH_MASK	(IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE)
+
+//structure to hold one file waiting for conversion
+typedef struct
+{
+	char *src_file;           // changed source file
+	char dest_file[PATH_MAX]; // html file to update
+	int result;               // convert_file return value
+	double msec;              // conversion time
+}watch_job_t;
+
+/********** global variables **********/
+
+static int inotify_fd = -1;
+
+/* directory path of every watch descriptor, indexed by wd */
+static char **watch_dirs = NULL;
+static int watch_dirs_size = 0;
+
+/* changed files waiting for the debounce time to pass */
+static char **pending = NULL;
+static int pending_count = 0;
+static int pending_size = 0;
+static double pending_since = 0;
+
+/* set while scanning a new directory, its files are queued too */
+static int scan_queue_files = 0;
+
+/* set by SIGINT or SIGTERM */
+static volatile sig_atomic_t watch_stopped = 0;
+
+/********** Utility functions **********/
+
+/* monotonic time in milli seconds */
+static double watch_now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/* remember the changed file, once per burst */
+static void watch_queue_file(const char *path)
+{
+	char **tmp, *copy;
+	int idx;
+
+	if(lang_lookup(path) == NULL) // not a source file (html output, temporary files, ...)
+		return;
+
+	for(idx = 0; idx < pending_count; idx++)
+	{
+		if(strcmp(pending[idx], path) == 0)
+			return;
+	}
+
+	if(pending_count == pending_size)
+	{
+		int size = pending_size ? pending_size * 2 : 16;
+		if((tmp = realloc(pending, size * sizeof(char *))) == NULL)
+		{
+			printf("Error! out of memory, %s is not updated\n", path);
+			return;
+		}
+		pending = tmp;
+		pending_size = size;
+	}
+
+	if((copy = strdup(path)) == NULL)
+	{
+		printf("Error! out of memory, %s is not updated\n", path);
+		return;
+	}
+
+	if(pending_count == 0)
+		pending_since = watch_now_ms();
+	pending[pending_count++] = copy;
+}
+
+static void watch_stop(int sig)
+{
+	(void)sig;
+	watch_stopped = 1;
+}
+
+/* nftw callback: watch every directory, queue source files of new directories */
+static int watch_add_entry(const char *path, const struct stat *sb, int flag, struct FTW *ftwbuf)
+{
+	char **tmp;
+	int wd;
+
+	(void)sb;
+	(void)ftwbuf;
+
+	if(flag == FTW_F)
+	{
+		if(scan_queue_files)
+			watch_queue_file(path);
+		return 0;
+	}
+
+	if(flag != FTW_D)
+		return 0;
+
+	if((wd = inotify_add_watch(inotify_fd, path, WATCH_MASK)) < 0)
+	{
+		printf("Error! could not watch %s : %s\n", path, strerror(errno));
+		return 0;
+	}
+
+	if(wd >= watch_dirs_size)
+	{
+		int size = watch_dirs_size ? watch_dirs_size : 64;
+		while(size <= wd)
+			size *= 2;
+		if((tmp = realloc(watch_dirs, size * sizeof(char *))) == NULL)
+		{
+			printf("Error! out of memory, %s is not watched\n", path);
+			inotify_rm_watch(inotify_fd, wd);
+			return 0;
+		}
+		watch_dirs = tmp;
+		memset(watch_dirs + watch_dirs_size, 0, (size - watch_dirs_size) * sizeof(char *));
+		watch_dirs_size = size;
+	}
+
+	free(watch_dirs[wd]);
+	watch_dirs[wd] = strdup(path);
+
+	return 0;
+}
+
+/* add watches for the directory and everything below it */
+static void watch_add_tree(const char *dir, int queue_files)
+{
+	scan_queue_files = queue_files;
+	nftw(dir, watch_add_entry, 16, FTW_PHYS);
+	scan_queue_files = 0;
+}
+
+/* pool job: convert one changed file */
+static void watch_convert_job(void *arg)
+{
+	watch_job_t *job = arg;
+	double start = watch_now_ms();
+
+	job->result = convert_file(job->src_file, job->dest_file);
+	job->msec = watch_now_ms() - start;
+}
+
+/* convert all pending files on the thread pool */
+static void watch_flush(pool_t *pool)
+{
+	watch_job_t *jobs;
+	int idx, count = pending_count;
+
+	if((jobs = calloc(count, sizeof(watch_job_t))) == NULL)
+		return;
+
+	for(idx = 0; idx < count; idx++)
+	{
+		jobs[idx].src_file = pending[idx];
+		snprintf(jobs[idx].dest_file, PATH_MAX, "%s.html", pending[idx]);
+		if(pool_submit(pool, watch_convert_job, &jobs[idx]) < 0)
+			jobs[idx].result = CONV_ERR_DEST; // never queued, the output is stale
+	}
+	pool_wait(pool);
+
+	for(idx = 0; idx < count; idx++)
+	{
+		if(jobs[idx].result == CONV_OK)
+			printf("Updated %s (%.2f ms)\n", jobs[idx].dest_file, jobs[idx].msec);
+		else if(jobs[idx].result == CONV_ERR_DEST)
+			printf("Error! could not create %s output file\n", jobs[idx].dest_file);
+		/* source errors are expected when a file is removed right after saving */
+		free(jobs[idx].src_file);
+	}
+	fflush(stdout);
+
+	free(jobs);
+	pending_count = 0;
+}
+
+/* read all queued inotify events */
+static int watch_read_events(void)
+{
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	char path[PATH_MAX];
+	const struct inotify_event *ev;
+	ssize_t len;
+	char *ptr;
+
+	while((len = read(inotify_fd, buf, sizeof(buf))) > 0)
+	{
+		for(ptr = buf; ptr < buf + len; ptr += sizeof(struct inotify_event) + ev->len)
+		{
+			ev = (const struct inotify_event *)ptr;
+
+			if(ev->mask & IN_Q_OVERFLOW)
+			{
+				printf("Warning! inotify queue overflow, some changes were missed\n");
+				continue;
+			}
+			if(ev->len == 0 || ev->wd >= watch_dirs_size || watch_dirs[ev->wd] == NULL)
+				continue;
+
+			snprintf(path, sizeof(path), "%s/%s", watch_dirs[ev->wd], ev->name);
+
+			if(ev->mask & IN_ISDIR)
+			{
+				if(ev->mask & (IN_CREATE | IN_MOVED_TO))
+					watch_add_tree(path, 1); // new directory, files may be there already
+			}
+			else if(ev->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+			{
+				watch_queue_file(path);
+			}
+		}
+	}
+
+	if(len < 0 && errno != EAGAIN && errno != EINTR)
+		return -1;
+
+	return 0;
+}
+
+/********** watch functions **********/
+
+/* keep converting source files below dir whenever they are saved */
+int watch_tree(const char *dir, int num_threads)
+{
+	struct sigaction sa;
+	struct timespec ts;
+	struct pollfd pfd;
+	sigset_t stop_set, wait_set;
+	pool_t *pool;
+	int ret;
+
+	if((inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0)
+	{
+		printf("Error! inotify is not available : %s\n", strerror(errno));
+		return 4;
+	}
+
+	/* the stop signals are blocked, in the workers too, except while waiting
+	 * in ppoll: stopping never cuts a conversion short and atexit handlers
+	 * (the --trace writer) run
+	 */
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = watch_stop;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	sigemptyset(&stop_set);
+	sigaddset(&stop_set, SIGINT);
+	sigaddset(&stop_set, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &stop_set, &wait_set);
+	sigdelset(&wait_set, SIGINT);
+	sigdelset(&wait_set, SIGTERM);
+
+	if((pool = pool_create(num_threads)) == NULL)
+	{
+		printf("Error! could not create worker threads\n");
+		close(inotify_fd);
+		return 4;
+	}
+
+	watch_add_tree(dir, 0);
+	if(watch_dirs == NULL)
+	{
+		printf("Error! could not watch directory %s\n", dir);
+		pool_destroy(pool);
+		close(inotify_fd);
+		return 2;
+	}
+	printf("Watching %s for changes\n", dir);
+	fflush(stdout);
+
+	pfd.fd = inotify_fd;
+	pfd.events = POLLIN;
+
+	while(!watch_stopped)
+	{
+		/* sleep without timeout when nothing is pending */
+		ts.tv_sec = 0;
+		ts.tv_nsec = WATCH_DEBOUNCE_MS * 1000000L;
+
+		if((ret = ppoll(&pfd, 1, pending_count ? &ts : NULL, &wait_set)) < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			break;
+		}
+
+		if(ret > 0 && watch_read_events() < 0)
+			break;
+
+		/* convert after a quiet period, or when events never stop coming */
+		if(pending_count && (ret == 0 || watch_now_ms() - pending_since >= WATCH_MAX_DELAY_MS))
+			watch_flush(pool);
+	}
+
+	if(watch_stopped)
+	{
+		if(pending_count)
+			watch_flush(pool);
+		printf("Stopped watching %s\n", dir);
+		ret = 0;
+	}
+	else
+	{
+		printf("Error! watching %s failed : %s\n", dir, strerror(errno));
+		ret = 4;
+	}
+	pool_destroy(pool);
+	close(inotify_fd);
+
+	return ret;
+}
+/**** End of file ****/
@@ -0,0 +1,14 @@
+#ifndef S2HTML_WATCH_H
+#define S2HTML_WATCH_H
+
+/* constants */
+
+#define WATCH_DEBOUNCE_MS	2  /* quiet time after the last event before converting */
+#define WATCH_MAX_DELAY_MS	50 /* convert anyway when events keep coming for this long */
+
+/********** function prototypes **********/
+
+int watch_tree(const char *dir, int num_threads); /* runs until SIGINT or SIGTERM, then returns 0 */
+
+#endif
+/**** End of file ****/
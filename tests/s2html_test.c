@@ -0,0 +1,896 @@
+/* Checks of the library API on a source file.
+ *
+ * usage: ./s2html_test <source file>
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include "s2html_event.h"
+#include "s2html_conv.h"
+#include "s2html_lang.h"
+#include "s2html_render.h"
+#include "s2html_cache.h"
+#include "s2html_io.h"
+#include "s2html_diff.h"
+#include "s2html_index.h"
+#include "s2html_view.h"
+
+#define TEST_BATCH_EVENTS	7 /* small, so that a file takes many batches */
+
+static int failed = 0;
+
+#define CHECK(cond, what) \
+	do { if(!(cond)) { printf("Error! %s\n", what); failed++; } } while(0)
+
+/********** Utility functions **********/
+
+/* whole file in a malloc'd buffer */
+static char *read_file(const char *file_name, size_t *len)
+{
+	char *buf = NULL;
+	FILE *fp, *mfp;
+	int ch;
+
+	if((fp = fopen(file_name, "r")) == NULL)
+		return NULL;
+	mfp = open_memstream(&buf, len);
+	while((ch = fgetc(fp)) != EOF)
+		fputc(ch, mfp);
+	fclose(mfp);
+	fclose(fp);
+
+	return buf;
+}
+
+/********** tests **********/
+
+static void test_lang(void)
+{
+	CHECK(strcmp(lang_lookup("a.c")->name, lang_lookup("a.h")->name) == 0, "a.c and a.h differ in language");
+	CHECK(lang_lookup("a.sh") != lang_lookup("a.c"), "a.sh is parsed as C");
+	CHECK(lang_lookup("a.unknown") == NULL, "unknown extension has a language");
+	CHECK(lang_keyword(lang_lookup("a.c"), "int") == RES_KEYWORD_DATA, "int is not a data keyword");
+	CHECK(lang_keyword(lang_lookup("a.c"), "while") == RES_KEYWORD_NON_DATA, "while is not a keyword");
+	CHECK(lang_keyword(lang_lookup("a.c"), "whilst") == 0, "whilst is a keyword");
+	CHECK(lang_keyword(lang_lookup("a.cpp"), "nullptr") == RES_KEYWORD_NON_DATA, "nullptr is not a C++ keyword");
+	CHECK(lang_keyword(lang_lookup("a.sh"), "esac") == RES_KEYWORD_NON_DATA, "esac is not a shell keyword");
+	CHECK(lang_keyword(lang_lookup("a.v"), "endmodule") == RES_KEYWORD_DATA, "endmodule is not a verilog keyword");
+	CHECK(lang_keyword(lang_lookup("a.v"), "nullptr") == 0, "nullptr is a verilog keyword");
+}
+
+/* every event of src as "<type>:<data>|", in the language of file_name */
+static char *lex(const char *file_name, const char *src)
+{
+	char *log = NULL;
+	size_t log_len;
+	pevent_t *event;
+	FILE *sfp, *lfp;
+
+	sfp = fmemopen((void *)src, strlen(src), "r");
+	lfp = open_memstream(&log, &log_len);
+	lang_select(file_name);
+	reset_parser();
+	do
+	{
+		event = get_parser_event(sfp);
+		fprintf(lfp, "%d:%.*s|", event->type, event->length, event->data);
+	} while(event->type != PEVENT_EOF);
+	fclose(lfp);
+	fclose(sfp);
+
+	return log;
+}
+
+/* true when lexing src gives an event of the type with exactly this data */
+static int lexes_to(const char *file_name, const char *src, pevent_e type, const char *data)
+{
+	char *log = lex(file_name, src), want[256];
+	int found;
+
+	snprintf(want, sizeof(want), "|%d:%s|", type, data);
+	found = strstr(log, want) != NULL || strncmp(log, want + 1, strlen(want + 1)) == 0;
+	free(log);
+
+	return found;
+}
+
+/* the rules the flags of languages.def turn on */
+static void test_lexer(void)
+{
+	CHECK(lexes_to("a.v", "x = 8'hFF;\n", PEVENT_NUMERIC_CONSTANT, "8'hFF"), "8'hFF is not a verilog number");
+	CHECK(lexes_to("a.v", "y = 4'b10_01 + 'd3;\n", PEVENT_NUMERIC_CONSTANT, "4'b10_01"), "4'b10_01 is not a verilog number");
+	CHECK(lexes_to("a.v", "y = 4'b10_01 + 'd3;\n", PEVENT_NUMERIC_CONSTANT, "'d3"), "'d3 is not a verilog number");
+	CHECK(!lexes_to("a.v", "x = 8'hFF;\n", PEVENT_ASCII_CHAR, "'hFF;\n"), "8'hFF lexes as a char");
+
+	CHECK(lexes_to("a.sh", "echo 'hello big world'\n", PEVENT_STRING, "'hello big world'"),
+			"shell single quoted string is not one string");
+	CHECK(lexes_to("a.sh", "echo 'a\\' b\n", PEVENT_STRING, "'a\\'"), "backslash escapes a single quote");
+	CHECK(lexes_to("a.sh", "echo \"say \\\"hi\\\"\"\n", PEVENT_STRING, "\"say \\\"hi\\\"\""),
+			"shell double quoted string lost its escapes");
+	CHECK(!lexes_to("a.sh", "n=${#arr[@]}\n", PEVENT_SINGLE_LINE_COMMENT, "#arr[@]}\n"), "${#arr[@]} starts a comment");
+	CHECK(lexes_to("a.sh", "echo $# # count\n", PEVENT_SINGLE_LINE_COMMENT, "# count\n"), "$# starts a comment");
+	CHECK(lexes_to("a.sh", "# top\n", PEVENT_SINGLE_LINE_COMMENT, "# top\n"), "# does not start a comment");
+	CHECK(lexes_to("a.c", "char c = 'x';\n", PEVENT_ASCII_CHAR, "'x'"), "'x' is not a C char");
+}
+
+/* one line per event */
+static void log_event(FILE *log, pevent_e type, int property, const char *data, int length)
+{
+	fprintf(log, "%d %d %d ", type, property, length);
+	fwrite(data, 1, length, log);
+	fputc('\n', log);
+}
+
+/* get_parser_events gives the events of get_parser_event */
+static void test_batch(const char *src_file, char *buf, size_t len)
+{
+	pevent_e types[TEST_BATCH_EVENTS];
+	int properties[TEST_BATCH_EVENTS];
+	long offsets[TEST_BATCH_EVENTS];
+	int lengths[TEST_BATCH_EVENTS];
+	char text[PEVENT_DATA_SIZE + 64];
+	pevent_batch_t batch = {types, properties, offsets, lengths, TEST_BATCH_EVENTS, text, sizeof(text), 0, 0};
+	char *single = NULL, *batched = NULL;
+	size_t single_len, batched_len;
+	pevent_t *event;
+	FILE *sfp, *log;
+	int idx;
+
+	sfp = fmemopen(buf, len, "r");
+	log = open_memstream(&single, &single_len);
+	lang_select(src_file);
+	reset_parser();
+	do
+	{
+		event = get_parser_event(sfp);
+		log_event(log, event->type, event->property, event->data, event->length);
+	} while(event->type != PEVENT_EOF);
+	fclose(log);
+	fclose(sfp);
+
+	sfp = fmemopen(buf, len, "r");
+	log = open_memstream(&batched, &batched_len);
+	lang_select(src_file);
+	reset_parser();
+	do
+	{
+		if(get_parser_events(sfp, &batch) == 0)
+			break;
+		for(idx = 0; idx < batch.count; idx++)
+			log_event(log, types[idx], properties[idx], text + offsets[idx], lengths[idx]);
+	} while(types[batch.count - 1] != PEVENT_EOF);
+	fclose(log);
+	fclose(sfp);
+
+	CHECK(single_len == batched_len && memcmp(single, batched, single_len) == 0,
+			"get_parser_events and get_parser_event differ");
+	free(single);
+	free(batched);
+}
+
+/* rendering in parallel chunks of chunk_tokens gives the page of convert_file */
+static void check_render(const char *src_file, int chunk_tokens)
+{
+	char serial[PATH_MAX], parallel[PATH_MAX];
+	char *serial_buf, *parallel_buf;
+	size_t serial_len, parallel_len;
+
+	snprintf(serial, sizeof(serial), "s2html_test.%d.serial.html", (int)getpid());
+	snprintf(parallel, sizeof(parallel), "s2html_test.%d.parallel.html", (int)getpid());
+
+	CHECK(convert_file(src_file, serial) == CONV_OK, "convert_file failed");
+	CHECK(render_file_parallel(src_file, parallel, 2, chunk_tokens) == CONV_OK, "render_file_parallel failed");
+
+	serial_buf = read_file(serial, &serial_len);
+	parallel_buf = read_file(parallel, &parallel_len);
+	CHECK(serial_buf && parallel_buf && serial_len == parallel_len &&
+			memcmp(serial_buf, parallel_buf, serial_len) == 0,
+			"render_file_parallel and convert_file differ");
+
+	free(serial_buf);
+	free(parallel_buf);
+	unlink(serial);
+	unlink(parallel);
+}
+
+/* small chunks of the source file, and default chunks of a file of several chunks */
+static void test_render(const char *src_file, char *buf, size_t len)
+{
+	char big[PATH_MAX];
+	FILE *fp;
+
+	check_render(src_file, 1);
+	check_render(src_file, 7);
+
+	snprintf(big, sizeof(big), "s2html_test.%d.big.c", (int)getpid());
+	fp = fopen(big, "w");
+	while(ftell(fp) < 4 * RENDER_CHUNK_TOKENS * 4) // test.c has about 3 bytes a token, 5 chunks
+		fwrite(buf, 1, len, fp);
+	fclose(fp);
+	check_render(big, 0);
+	unlink(big);
+}
+
+/* tokens longer than an event come in pieces, serial, batched and parallel alike */
+static void test_long_tokens(void)
+{
+	static const char *parts[] = {"/* ", " */\n", "// ", "\n", "char *s = \"", "\";\n",
+		"#include <", ".h>\n", "#define LONG", "x\n", "", " = 1;\n", "n = ", ";\n"};
+	static const char fill[] = {'c', 'c', 's', 'h', ' ', 'w', '9'};
+	char src[PATH_MAX], *buf, *text = NULL;
+	size_t len, text_len;
+	pevent_t *event;
+	FILE *sfp, *tfp;
+	int idx, n, bounded = 1;
+
+	snprintf(src, sizeof(src), "s2html_test.%d.long.c", (int)getpid());
+	sfp = fopen(src, "w");
+	for(idx = 0; idx < 7; idx++)
+	{
+		fputs(parts[2 * idx], sfp);
+		for(n = 0; n < (idx ? 3000 : 20000); n++)
+			fputc(fill[idx], sfp);
+		fputs(parts[2 * idx + 1], sfp);
+	}
+	fclose(sfp);
+	buf = read_file(src, &len);
+
+	/* the events give back every byte of the source */
+	sfp = fmemopen(buf, len, "r");
+	tfp = open_memstream(&text, &text_len);
+	lang_select(src);
+	reset_parser();
+	do
+	{
+		event = get_parser_event(sfp);
+		bounded &= event->length < PEVENT_DATA_SIZE && (int)strlen(event->data) == event->length;
+		if(event->type == PEVENT_HEADER_FILE && event->property != USER_HEADER_FILE)
+			fprintf(tfp, "<%s>", event->data);
+		else
+			fputs(event->data, tfp);
+	} while(event->type != PEVENT_EOF);
+	fclose(tfp);
+	fclose(sfp);
+	CHECK(bounded, "an event outgrew its data");
+	CHECK(text_len == len && memcmp(text, buf, len) == 0, "the events of long tokens lost bytes");
+
+	test_batch(src, buf, len);
+	check_render(src, 0);
+	check_render(src, 3);
+
+	free(text);
+	free(buf);
+	unlink(src);
+}
+
+/* pages built with the fragment cache, cold and warm, are the pages of convert_buffer */
+static void test_cache(const char *src_file, char *buf, size_t len)
+{
+	cache_t *cache = cache_create(1024 * 1024);
+	cache_stats_t stats;
+	char *page[3] = {NULL, NULL, NULL};
+	size_t page_len[3];
+	FILE *dfp;
+	int idx;
+
+	for(idx = 0; idx < 3; idx++)
+	{
+		dfp = open_memstream(&page[idx], &page_len[idx]);
+		if(idx == 0)
+			convert_buffer(src_file, buf, len, dfp, NULL, NULL);
+		else
+			cache_convert_buffer(cache, src_file, buf, len, dfp);
+		fclose(dfp);
+	}
+	cache_get_stats(cache, &stats);
+
+	CHECK(page_len[1] == page_len[0] && memcmp(page[1], page[0], page_len[0]) == 0,
+			"cache_convert_buffer differs from convert_buffer");
+	CHECK(page_len[2] == page_len[0] && memcmp(page[2], page[0], page_len[0]) == 0,
+			"cache_convert_buffer with cached blocks differs from convert_buffer");
+	CHECK(stats.hits == stats.inserts, "second run missed cached blocks");
+
+	for(idx = 0; idx < 3; idx++)
+		free(page[idx]);
+	cache_destroy(cache);
+}
+
+/* render function of io_convert_files */
+static int render_plain(const char *src_file, const char *buf, size_t len, FILE *dfp, void *ctx)
+{
+	(void)ctx;
+	return convert_buffer(src_file, buf, len, dfp, NULL, NULL);
+}
+
+/* a file that grew after it was listed is converted whole by every backend */
+static void test_io(char *buf, size_t len)
+{
+	char src[PATH_MAX], serial[PATH_MAX], html[PATH_MAX];
+	char *files[1] = {src}, *serial_buf, *html_buf;
+	size_t serial_len, html_len;
+	long sizes[1] = {1};
+	int backends[2] = {IO_BACKEND_BLOCKING, IO_BACKEND_AUTO}; // auto is io_uring when built with it
+	io_stats_t stats;
+	FILE *fp;
+	int idx;
+
+	snprintf(src, sizeof(src), "s2html_test.%d.grown.c", (int)getpid());
+	snprintf(serial, sizeof(serial), "s2html_test.%d.serial.html", (int)getpid());
+	snprintf(html, sizeof(html), "%s.html", src);
+
+	/* bigger than the registered read buffer of the uring backend */
+	fp = fopen(src, "w");
+	while(ftell(fp) < 3 * IO_BUF_SIZE)
+		fwrite(buf, 1, len, fp);
+	fclose(fp);
+	CHECK(convert_file(src, serial) == CONV_OK, "convert_file failed");
+	serial_buf = read_file(serial, &serial_len);
+
+	for(idx = 0; idx < 2; idx++)
+	{
+		unlink(html);
+		io_convert_files(files, sizes, 1, backends[idx], render_plain, NULL, &stats);
+		html_buf = read_file(html, &html_len);
+		CHECK(stats.files == 1 && stats.failed == 0, "io_convert_files failed on a grown file");
+		CHECK(serial_buf && html_buf && serial_len == html_len && memcmp(serial_buf, html_buf, html_len) == 0,
+				"io_convert_files truncated a file that grew after it was listed");
+		free(html_buf);
+	}
+
+	free(serial_buf);
+	unlink(src);
+	unlink(serial);
+	unlink(html);
+}
+
+/* tokens i of a and j of b are the same */
+static int diff_same(diff_file_t *a, int i, diff_file_t *b, int j)
+{
+	diff_token_t *ta = &a->tokens[i], *tb = &b->tokens[j];
+
+	return ta->type == tb->type && ta->property == tb->property && ta->length == tb->length &&
+		memcmp(a->text + ta->offset, b->text + tb->offset, ta->length) == 0;
+}
+
+/* lines i of a and j of b are the same */
+static int diff_same_line(diff_file_t *a, int i, diff_file_t *b, int j)
+{
+	diff_line_t *la = &a->lines[i], *lb = &b->lines[j];
+	int idx;
+
+	for(idx = 0; la->count == lb->count && idx < la->count; idx++)
+	{
+		if(!diff_same(a, la->first + idx, b, lb->first + idx))
+			return 0;
+	}
+
+	return la->count == lb->count;
+}
+
+/* length of the longest common subsequence of the lines, by dynamic programming */
+static int diff_lcs(diff_file_t *a, diff_file_t *b)
+{
+	int *prev = calloc(b->num_lines + 1, sizeof(int)), *cur = calloc(b->num_lines + 1, sizeof(int)), *tmp;
+	int i, j, lcs;
+
+	for(i = 1; i <= a->num_lines; i++)
+	{
+		for(j = 1; j <= b->num_lines; j++)
+		{
+			if(diff_same_line(a, i - 1, b, j - 1))
+				cur[j] = prev[j - 1] + 1;
+			else
+				cur[j] = prev[j] > cur[j - 1] ? prev[j] : cur[j - 1];
+		}
+		tmp = prev;
+		prev = cur;
+		cur = tmp;
+	}
+	lcs = prev[b->num_lines];
+	free(prev);
+	free(cur);
+
+	return lcs;
+}
+
+/* diff_mark_lines keeps as many lines as an LCS, diff_mark keeps equal tokens only */
+static void diff_check_minimal(const char *old_file, const char *new_file)
+{
+	diff_file_t a, b;
+	char *del, *ins;
+	int i = 0, j = 0, kept = 0, valid = 1;
+
+	if(diff_read_file(old_file, &a) < 0 || diff_read_file(new_file, &b) < 0)
+	{
+		CHECK(0, "diff_read_file failed");
+		return;
+	}
+
+	del = malloc(a.num_lines + 1);
+	ins = malloc(b.num_lines + 1);
+	CHECK(diff_mark_lines(&a, &b, del, ins) == 0, "diff_mark_lines failed");
+	while(valid && (i < a.num_lines || j < b.num_lines))
+	{
+		if(i < a.num_lines && del[i])
+			i++;
+		else if(j < b.num_lines && ins[j])
+			j++;
+		else if((valid = i < a.num_lines && j < b.num_lines && diff_same_line(&a, i++, &b, j++)))
+			kept++;
+	}
+	CHECK(valid, "diff_mark_lines keeps lines that differ");
+	CHECK(kept == diff_lcs(&a, &b), "diff_mark_lines does not keep a longest common subsequence");
+	free(del);
+	free(ins);
+
+	del = malloc(a.count + 1);
+	ins = malloc(b.count + 1);
+	CHECK(diff_mark(&a, &b, del, ins) == 0, "diff_mark failed");
+	for(i = j = 0, valid = 1; valid && (i < a.count || j < b.count); )
+	{
+		if(i < a.count && del[i])
+			i++;
+		else if(j < b.count && ins[j])
+			j++;
+		else
+			valid = i < a.count && j < b.count && diff_same(&a, i++, &b, j++);
+	}
+	CHECK(valid, "diff_mark keeps tokens that differ");
+	free(del);
+	free(ins);
+
+	diff_free_file(&a);
+	diff_free_file(&b);
+}
+
+/* lines of column col (0 left, 1 right) of a diff page, without tags */
+static int diff_column(const char *page, int col, char lines[][64], int max)
+{
+	const char *p = strstr(page, "<table class=\"diff\">");
+	int count = 0, len = 0, tag = 0;
+
+	p = p ? strstr(p, "<pre>\n") : NULL;
+	if(p && col)
+		p = strstr(p + 1, "<pre>\n");
+	if(p == NULL)
+		return -1;
+
+	for(p += strlen("<pre>\n"); *p && strncmp(p, "</pre>", 6) && count < max; p++)
+	{
+		if(*p == '<' || *p == '>')
+			tag = *p == '<';
+		else if(*p == '\n')
+		{
+			lines[count++][len] = '\0';
+			len = 0;
+		}
+		else if(!tag && len < 63)
+			lines[count][len++] = *p;
+	}
+
+	return count;
+}
+
+/* minimal edits, and unchanged lines side by side in the page */
+static void test_diff(void)
+{
+	const char *old_src = "int keep1;\nint gone1;\nint keep2;\nint keep3;\nx = 1;\nint keep4;\n";
+	const char *new_src = "int keep1;\nint keep2;\nint new1;\nint new2;\nint keep3;\nx = 2;\nint keep4;\n";
+	const char *pool[] = {"int a;\n", "a = b + 1;\n", "if(a)\n", "\treturn a;\n", "/* note */\n", "b++;\n"};
+	char old_file[PATH_MAX], new_file[PATH_MAX], html[PATH_MAX];
+	char left[32][64], right[32][64], *page;
+	unsigned int seed = 12345;
+	size_t page_len;
+	int rows, idx, line, keep;
+	FILE *fp;
+
+	snprintf(old_file, sizeof(old_file), "s2html_test.%d.old.c", (int)getpid());
+	snprintf(new_file, sizeof(new_file), "s2html_test.%d.new.c", (int)getpid());
+	snprintf(html, sizeof(html), "s2html_test.%d.diff.html", (int)getpid());
+
+	fp = fopen(old_file, "w");
+	fputs(old_src, fp);
+	fclose(fp);
+	fp = fopen(new_file, "w");
+	fputs(new_src, fp);
+	fclose(fp);
+	diff_check_minimal(old_file, new_file);
+
+	CHECK(diff_files(old_file, new_file, html) == CONV_OK, "diff_files failed");
+	page = read_file(html, &page_len);
+	rows = page ? diff_column(page, 0, left, 32) : -1;
+	CHECK(rows > 0 && rows == diff_column(page, 1, right, 32), "diff columns have different heights");
+	for(keep = 1; keep <= 4 && rows > 0; keep++)
+	{
+		char want[32];
+
+		snprintf(want, sizeof(want), "int keep%d;", keep);
+		for(idx = 0; idx < rows && strcmp(left[idx], want); idx++)
+			;
+		CHECK(idx < rows && strcmp(right[idx], want) == 0, "unchanged line is not next to itself");
+	}
+	for(idx = 0; idx < rows; idx++)
+	{
+		if(strcmp(left[idx], "x = 1;") == 0)
+			CHECK(strcmp(right[idx], "x = 2;") == 0, "changed line is not next to its new version");
+	}
+	free(page);
+
+	/* random edits of random lines */
+	for(idx = 0; idx < 20; idx++)
+	{
+		fp = fopen(old_file, "w");
+		for(line = 0; line < 40; line++)
+			fputs(pool[((seed = seed * 1103515245u + 12345u) >> 16) % 6], fp);
+		fclose(fp);
+		fp = fopen(new_file, "w");
+		for(line = 0; line < 40; line++)
+			fputs(pool[((seed = seed * 1103515245u + 12345u) >> 16) % 6], fp);
+		fclose(fp);
+		diff_check_minimal(old_file, new_file);
+	}
+
+	unlink(old_file);
+	unlink(new_file);
+	unlink(html);
+}
+
+/* output of index_query, stdout goes to a file meanwhile */
+static char *query_output(const char *index_file, const char *text)
+{
+	char out_file[PATH_MAX], *out;
+	size_t out_len;
+	int saved;
+
+	snprintf(out_file, sizeof(out_file), "s2html_test.%d.query", (int)getpid());
+	fflush(stdout);
+	saved = dup(STDOUT_FILENO);
+	if(freopen(out_file, "w", stdout) == NULL)
+		return NULL;
+	index_query(index_file, NULL, text);
+	fflush(stdout);
+	dup2(saved, STDOUT_FILENO);
+	close(saved);
+	out = read_file(out_file, &out_len);
+	unlink(out_file);
+
+	return out;
+}
+
+/* index positions are source bytes, a capped query says so, a damaged index is refused */
+static void test_index(const char *src_file, char *buf, size_t len)
+{
+	char many[PATH_MAX], index_file[PATH_MAX], bad_file[PATH_MAX], want[PATH_MAX + 32];
+	char *many_buf, *index_buf, *bad_buf, *out, *parts[1] = {bad_file};
+	size_t many_len, index_len, bad_len;
+	index_builder_t *idx = index_create();
+	index_header_t *hdr;
+	index_file_t *files;
+	index_trigram_t *tris;
+	FILE *fp, *dfp = fopen("/dev/null", "w");
+	int line, damage;
+	uint32_t i;
+
+	snprintf(many, sizeof(many), "s2html_test.%d.many.c", (int)getpid());
+	snprintf(index_file, sizeof(index_file), "s2html_test.%d.idx", (int)getpid());
+	fp = fopen(many, "w");
+	for(line = 0; line < INDEX_MAX_RESULTS + 200; line++)
+		fprintf(fp, "\tcount = %d;\n", line);
+	fclose(fp);
+	many_buf = read_file(many, &many_len);
+
+	index_begin_file(idx, src_file);
+	convert_buffer(src_file, buf, len, dfp, index_add_event, idx);
+	index_begin_file(idx, many);
+	convert_buffer(many, many_buf, many_len, dfp, index_add_event, idx);
+	CHECK(index_write(idx, index_file) == 0, "index_write failed");
+	index_destroy(idx);
+	fclose(dfp);
+
+	out = query_output(index_file, "<stdio.h>");
+	snprintf(want, sizeof(want), "%s:4: #include <stdio.h>\n", src_file);
+	CHECK(out && strstr(out, want), "<stdio.h> is not found at its line");
+	free(out);
+
+	out = query_output(index_file, "count = ");
+	CHECK(out && strstr(out, "truncated at 1000 matches\n"), "capped query does not say it was truncated");
+	free(out);
+	out = query_output(index_file, "count = 12;");
+	CHECK(out && !strstr(out, "truncated"), "query under the cap says it was truncated");
+	free(out);
+
+	/* cut off, posting lists and file entries pointing out of the file */
+	snprintf(bad_file, sizeof(bad_file), "s2html_test.%d.bad.idx", (int)getpid());
+	index_buf = read_file(index_file, &index_len);
+	for(damage = 0; damage < 3; damage++)
+	{
+		bad_buf = malloc(index_len);
+		memcpy(bad_buf, index_buf, index_len);
+		bad_len = index_len;
+		hdr = (index_header_t *)bad_buf;
+		files = (index_file_t *)(bad_buf + hdr->files_off);
+		tris = (index_trigram_t *)(bad_buf + hdr->trigrams_off);
+		if(damage == 0)
+			bad_len = hdr->trigrams_off + sizeof(index_trigram_t);
+		for(i = 0; damage == 1 && i < hdr->num_trigrams; i++)
+			tris[i].post_len = UINT64_MAX - 8;
+		for(i = 0; damage == 2 && i < hdr->num_files; i++)
+		{
+			files[i].name_off = UINT32_MAX;
+			files[i].lines_off = index_len;
+		}
+		fp = fopen(bad_file, "w");
+		fwrite(bad_buf, bad_len, 1, fp);
+		fclose(fp);
+
+		out = query_output(bad_file, "count = ");
+		CHECK(out && strncmp(out, "Error!", 6) == 0, "query of a damaged index is not refused");
+		free(out);
+		CHECK(index_merge(parts, 1, index_file) < 0, "merge of a damaged index is not refused");
+		free(bad_buf);
+	}
+
+	free(index_buf);
+	free(many_buf);
+	unlink(many);
+	unlink(index_file);
+	unlink(bad_file);
+}
+
+/* ints of "name":[...] in the token json of a view page, count in n */
+static int *view_ints(const char *page, const char *name, long *n)
+{
+	char key[64];
+	const char *p;
+	int *ints = NULL;
+	long size = 0;
+	char *end;
+
+	*n = 0;
+	snprintf(key, sizeof(key), "\"%s\":[", name);
+	if((p = strstr(page, key)) == NULL)
+		return NULL;
+	for(p += strlen(key); *p != ']'; p = (*end == ',') ? end + 1 : end)
+	{
+		if(*n == size)
+		{
+			size = size ? size * 2 : 1024;
+			ints = realloc(ints, size * sizeof(int));
+		}
+		ints[(*n)++] = strtol(p, &end, 10);
+		if(end == p)
+			break;
+	}
+
+	return ints;
+}
+
+/* css class names of the token json of a view page */
+static int view_class_names(const char *page, char names[][32], int max)
+{
+	const char *p = strstr(page, "\"classes\":[");
+	int n = 0, len;
+
+	if(p == NULL)
+		return 0;
+	for(p += strlen("\"classes\":["); *p == '"' && n < max; n++)
+	{
+		len = strchr(p + 1, '"') - (p + 1);
+		snprintf(names[n], 32, "%.*s", len, p + 1);
+		p += len + 2;
+		if(*p == ',')
+			p++;
+	}
+
+	return n;
+}
+
+/* source of a view page, base64 decoded */
+static char *view_source(const char *page, long *len)
+{
+	static const char digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	const char *p = strstr(page, "id=\"s2h_source\">"), *d;
+	unsigned long bits = 0;
+	char *out;
+	int nbits = 0;
+
+	*len = 0;
+	if(p == NULL || (out = malloc(strlen(p))) == NULL)
+		return NULL;
+	for(p += strlen("id=\"s2h_source\">"); *p != '<' && *p != '='; p++)
+	{
+		if((d = strchr(digits, *p)) == NULL)
+			break;
+		bits = (bits << 6) | (d - digits);
+		if((nbits += 6) >= 8)
+		{
+			nbits -= 8;
+			out[(*len)++] = (bits >> nbits) & 0xff;
+		}
+	}
+
+	return out;
+}
+
+/* text of a convert_file page and the class code (index in names, 0 for plain
+ * text, -1 for a class the view does not know) of every byte
+ */
+static long page_codes(const char *page, char names[][32], int num_names, char *text, int *codes)
+{
+	const char *p = strstr(page, "<pre>\n"), *end = strstr(page, "</pre>\n</body>");
+	long len = 0;
+	int code = 0, idx, in_span = 0;
+
+	if(p == NULL || end == NULL)
+		return -1;
+	for(p += strlen("<pre>\n"); p < end; )
+	{
+		if(!in_span && strncmp(p, "<span class=\"", 13) == 0)
+		{
+			p += 13;
+			for(code = -1, idx = 1; idx < num_names; idx++)
+			{
+				if(strncmp(p, names[idx], strlen(names[idx])) == 0 && p[strlen(names[idx])] == '"')
+					code = idx;
+			}
+			p = strstr(p, "\">") + 2;
+			in_span = 1;
+			continue;
+		}
+		if(in_span && strncmp(p, "</span>", 7) == 0)
+		{
+			p += 7;
+			code = 0;
+			in_span = 0;
+			continue;
+		}
+		/* only the brackets of a standard header are escaped */
+		if(in_span && strncmp(p, "&lt;", 4) == 0)
+		{
+			text[len] = '<';
+			p += 4;
+		}
+		else if(in_span && strncmp(p, "&gt;", 4) == 0)
+		{
+			text[len] = '>';
+			p += 4;
+		}
+		else
+			text[len] = *p++;
+		codes[len++] = code;
+	}
+
+	return len;
+}
+
+/* the source and tokens a view page carries are the ones of the convert_file page */
+static void check_view(const char *src_file)
+{
+	char view[PATH_MAX], page[PATH_MAX], html[PATH_MAX], names[16][32], *view_buf, *page_buf, *text, *src;
+	int *line_len, *line_toks, *toks, *codes, *page_codes_buf, num_names;
+	long lines, num_line_toks, num_toks, src_len, page_len, line, start, tok, col, idx;
+	size_t view_len, page_buf_len;
+
+	snprintf(view, sizeof(view), "s2html_test.%d.view", (int)getpid());
+	snprintf(page, sizeof(page), "s2html_test.%d.page", (int)getpid());
+	snprintf(html, sizeof(html), "%s.html", view);
+	CHECK(view_file(src_file, html) == CONV_OK, "view_file failed");
+	snprintf(html, sizeof(html), "%s.html", page);
+	CHECK(convert_file(src_file, html) == CONV_OK, "convert_file failed");
+	snprintf(html, sizeof(html), "%s.html", view);
+	view_buf = read_file(html, &view_len);
+	unlink(html);
+	snprintf(html, sizeof(html), "%s.html", page);
+	page_buf = read_file(html, &page_buf_len);
+	unlink(html);
+	if(view_buf == NULL || page_buf == NULL)
+	{
+		CHECK(0, "view or convert page is missing");
+		free(view_buf);
+		free(page_buf);
+		return;
+	}
+
+	num_names = view_class_names(view_buf, names, 16);
+	line_len = view_ints(view_buf, "line_len", &lines);
+	line_toks = view_ints(view_buf, "line_toks", &num_line_toks);
+	toks = view_ints(view_buf, "toks", &num_toks);
+	src = view_source(view_buf, &src_len);
+
+	/* class code of every byte as the view script builds the lines */
+	codes = calloc(src_len + 1, sizeof(int));
+	for(line = 0, start = 0, tok = 0; line < lines && line < num_line_toks; line++)
+	{
+		for(idx = 0; idx < line_toks[line] && tok * 3 + 2 < num_toks; idx++, tok++)
+		{
+			for(col = toks[tok * 3]; col < toks[tok * 3] + toks[tok * 3 + 1] && start + col < src_len; col++)
+				codes[start + col] = toks[tok * 3 + 2];
+		}
+		start += line_len[line] + 1;
+	}
+	CHECK(num_names > 1 && lines == num_line_toks && tok * 3 == num_toks,
+			"view tokens do not add up with the lines");
+	CHECK(start == src_len || start == src_len + 1, "view line lengths do not add up with the source");
+
+	text = malloc(page_buf_len);
+	page_codes_buf = malloc(page_buf_len * sizeof(int));
+	page_len = page_codes(page_buf, names, num_names, text, page_codes_buf);
+	CHECK(page_len == src_len && memcmp(text, src, src_len) == 0, "view source differs from the convert_file text");
+	for(idx = 0; page_len == src_len && idx < src_len; idx++)
+	{
+		/* the view splits tokens at line ends, a new line has no class there */
+		if(src[idx] != '\n' && codes[idx] != page_codes_buf[idx])
+		{
+			printf("Error! view class %s at byte %ld of %s, convert_file has %s\n", names[codes[idx]],
+					idx, src_file, page_codes_buf[idx] < 0 ? "?" : names[page_codes_buf[idx]]);
+			failed++;
+			break;
+		}
+	}
+
+	free(text);
+	free(page_codes_buf);
+	free(codes);
+	free(src);
+	free(toks);
+	free(line_toks);
+	free(line_len);
+	free(view_buf);
+	free(page_buf);
+}
+
+/* view pages of the test source and of a file with a comment over several
+ * lines, a standard header and no new line at the end
+ */
+static void test_view(const char *src_file)
+{
+	char src[PATH_MAX];
+	FILE *fp;
+
+	check_view(src_file);
+
+	snprintf(src, sizeof(src), "s2html_test.%d.view.c", (int)getpid());
+	fp = fopen(src, "w");
+	fprintf(fp, "#include <stdio.h>\n/* one\n   two\n\n   three */\nint main(void)\n{\n\treturn printf(\"%%d\\n\", 'a' + 10);\n}");
+	fclose(fp);
+	check_view(src);
+	unlink(src);
+}
+
+int main(int argc, char *argv[])
+{
+	char *buf;
+	size_t len;
+
+	if(argc < 2)
+	{
+		printf("Usage: %s <source file>\n", argv[0]);
+		return 1;
+	}
+	if((buf = read_file(argv[1], &len)) == NULL)
+	{
+		printf("Error! File %s could not be opened\n", argv[1]);
+		return 2;
+	}
+
+	test_lang();
+	test_lexer();
+	test_batch(argv[1], buf, len);
+	test_render(argv[1], buf, len);
+	test_long_tokens();
+	test_cache(argv[1], buf, len);
+	test_io(buf, len);
+	test_diff();
+	test_index(argv[1], buf, len);
+	test_view(argv[1]);
+
+	free(buf);
+	if(failed)
+		printf("%d checks failed\n", failed);
+
+	return failed ? 1 : 0;
+}
+/**** End of file ****/
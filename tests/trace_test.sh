@@ -0,0 +1,71 @@
+#!/bin/sh
+# Checks of --trace: the page of a traced run, of a file with a comment
+# longer than an event, is the page of a plain run, the trace holds the
+# phases of the file, and a watch stopped by SIGTERM writes its trace.
+#
+# usage: tests/trace_test.sh <s2html binary> <work dir> <source file>
+
+BIN=${1:?usage: $0 <s2html binary> <work dir> <source file>}
+WORK=${2:?usage: $0 <s2html binary> <work dir> <source file>}
+SRC=${3:?usage: $0 <s2html binary> <work dir> <source file>}
+
+rm -rf "$WORK"
+mkdir -p "$WORK"
+
+# the source file after a 3 KB comment
+{
+	printf '/* '
+	i=0
+	while [ $i -lt 60 ]; do
+		printf 'a long comment that does not fit in one event of the lexer '
+		i=$((i + 1))
+	done
+	printf '*/\n'
+	cat "$SRC"
+} > "$WORK/long.c"
+
+"$BIN" "$WORK/long.c" "$WORK/plain" > /dev/null || exit 1
+"$BIN" --trace "$WORK/trace.json" "$WORK/long.c" "$WORK/traced" > /dev/null || exit 1
+
+if ! cmp -s "$WORK/plain.html" "$WORK/traced.html"; then
+	echo "Error! the traced page differs from the plain page"
+	exit 1
+fi
+
+for phase in open read convert flush close; do
+	if ! grep -q "\"name\":\"$phase\".*long.c" "$WORK/trace.json"; then
+		echo "Error! no $phase phase of long.c in the trace"
+		exit 1
+	fi
+done
+if ! grep -q "\"name\":\"convert\".*long.c\",\"get_parser_event_ms\":.*,\"source_to_html_ms\":" "$WORK/trace.json"; then
+	echo "Error! the convert phase has no lexing and rendering times"
+	exit 1
+fi
+
+# a watch only ends with a signal
+mkdir "$WORK/tree"
+"$BIN" --trace "$WORK/watch.json" --watch "$WORK/tree" > "$WORK/watch.log" 2>&1 &
+PID=$!
+tries=0
+until grep -q "Watching" "$WORK/watch.log"; do
+	tries=$((tries + 1))
+	[ $tries -gt 50 ] && break
+	sleep 0.1
+done
+cp "$WORK/long.c" "$WORK/tree/watched.c"
+tries=0
+until grep -q "Updated" "$WORK/watch.log"; do
+	tries=$((tries + 1))
+	[ $tries -gt 50 ] && break
+	sleep 0.1
+done
+kill -TERM $PID
+wait $PID
+if ! grep -q "\"name\":\"convert\".*watched.c" "$WORK/watch.json" 2> /dev/null; then
+	echo "Error! the trace of the stopped watch has no convert phase of watched.c"
+	cat "$WORK/watch.log"
+	exit 1
+fi
+
+echo "trace ok"
@@ -0,0 +1,78 @@
+#!/bin/sh
+# Checks of --watch: a saved file, a file moved in and a file of a new
+# directory are converted, and the pages are the pages of a plain run.
+#
+# usage: tests/watch_test.sh <s2html binary> <work dir> <source file>
+
+BIN=${1:?usage: $0 <s2html binary> <work dir> <source file>}
+WORK=${2:?usage: $0 <s2html binary> <work dir> <source file>}
+SRC=${3:?usage: $0 <s2html binary> <work dir> <source file>}
+
+rm -rf "$WORK"
+mkdir -p "$WORK/tree"
+"$BIN" "$SRC" "$WORK/ref" > /dev/null || exit 1
+
+"$BIN" --watch "$WORK/tree" > "$WORK/watch.log" 2>&1 &
+PID=$!
+trap 'kill $PID 2> /dev/null' EXIT
+
+# wait up to 5 s for the file to show up
+wait_for()
+{
+	tries=0
+	while [ ! -f "$1" ]; do
+		tries=$((tries + 1))
+		if [ $tries -gt 50 ]; then
+			echo "Error! $1 was not generated"
+			cat "$WORK/watch.log"
+			exit 1
+		fi
+		sleep 0.1
+	done
+}
+
+wait_for_log()
+{
+	tries=0
+	until grep -q "$1" "$WORK/watch.log"; do
+		tries=$((tries + 1))
+		if [ $tries -gt 50 ]; then
+			echo "Error! no \"$1\" in the watch output"
+			cat "$WORK/watch.log"
+			exit 1
+		fi
+		sleep 0.1
+	done
+}
+
+wait_for_log "Watching"
+
+# saved in place
+cp "$SRC" "$WORK/tree/saved.c"
+wait_for_log "saved.c.html"
+
+# written elsewhere and moved in, as editors save
+cp "$SRC" "$WORK/moved.tmp"
+mv "$WORK/moved.tmp" "$WORK/tree/moved.c"
+wait_for_log "moved.c.html"
+
+# a new directory is watched too
+mkdir "$WORK/tree/sub"
+sleep 0.2
+cp "$SRC" "$WORK/tree/sub/new.c"
+wait_for_log "new.c.html"
+
+# html output and unknown extensions are not converted
+echo "text" > "$WORK/tree/notes.txt"
+sleep 0.2
+
+for page in saved.c moved.c sub/new.c; do
+	wait_for "$WORK/tree/$page.html"
+	cmp "$WORK/ref.html" "$WORK/tree/$page.html" || exit 1
+done
+if [ -f "$WORK/tree/notes.txt.html" ] || [ -f "$WORK/tree/saved.c.html.html" ]; then
+	echo "Error! a file that is not source was converted"
+	exit 1
+fi
+
+echo "watch checks passed"
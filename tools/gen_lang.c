@@ -0,0 +1,315 @@
+/* Compile languages.def into the read-only tables of s2html_lang.c: per
+ * language a keyword table with a perfect hash (one probe per lookup)
+ * and a class for every character.
+ *
+ * usage: ./gen_lang <languages.def> <output .c file>
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "s2html_event.h"
+#include "s2html_lang.h"
+
+#define GEN_MAX_LANGUAGES	64
+#define GEN_MAX_WORDS		512  /* keywords of one language */
+#define GEN_MAX_EXTENSIONS	32
+#define GEN_MAX_SEEDS		1000000 /* seeds tried per table size */
+#define GEN_LINE_SIZE		1024
+
+//structure to hold one language while it is read
+typedef struct
+{
+	char *name;
+	char *extensions[GEN_MAX_EXTENSIONS];
+	int num_extensions;
+	char *words[GEN_MAX_WORDS];
+	int types[GEN_MAX_WORDS];
+	int num_words;
+	unsigned char char_class[256];
+	int directive_char;
+	int line_comment_char;
+	int flags;
+	unsigned int seed;
+	unsigned int size;          // slots of the keyword table, power of two
+}gen_lang_t;
+
+static const struct
+{
+	const char *name;
+	int flag;
+} gen_flags[] = {
+	{"c_comments", LANG_C_COMMENTS},
+	{"sized_literals", LANG_SIZED_LITERALS},
+	{"single_quotes", LANG_SINGLE_QUOTES},
+	{"dollar_vars", LANG_DOLLAR_VARS},
+};
+
+#define NUM_GEN_FLAGS (int)(sizeof(gen_flags) / sizeof(gen_flags[0]))
+
+static gen_lang_t langs[GEN_MAX_LANGUAGES];
+static int num_langs = 0;
+
+/********** Utility functions **********/
+
+/* add the keywords of a line to the language */
+static int gen_add_words(gen_lang_t *lang, char *words, int type)
+{
+	char *word;
+	int idx;
+
+	for(word = strtok(words, " \t"); word; word = strtok(NULL, " \t"))
+	{
+		for(idx = 0; idx < lang->num_words; idx++)
+		{
+			if(strcmp(lang->words[idx], word) == 0)
+			{
+				printf("Error! keyword %s of %s is defined twice\n", word, lang->name);
+				return -1;
+			}
+		}
+		if(lang->num_words == GEN_MAX_WORDS)
+		{
+			printf("Error! %s has more than %d keywords\n", lang->name, GEN_MAX_WORDS);
+			return -1;
+		}
+		lang->words[lang->num_words] = strdup(word);
+		lang->types[lang->num_words] = type;
+		lang->num_words++;
+	}
+
+	return 0;
+}
+
+/* one line of the definition file, -1 on error */
+static int gen_parse_line(char *line, int line_no)
+{
+	gen_lang_t *lang = num_langs ? &langs[num_langs - 1] : NULL;
+	char *key, *value, *word;
+	int idx;
+
+	line[strcspn(line, "\r\n")] = '\0';
+	key = line + strspn(line, " \t");
+	if(*key == '\0' || *key == '#')
+		return 0;
+
+	value = key + strcspn(key, " \t");
+	if(*value)
+		*value++ = '\0';
+	value += strspn(value, " \t");
+
+	if(strcmp(key, "language") == 0)
+	{
+		if(num_langs == GEN_MAX_LANGUAGES || *value == '\0')
+		{
+			printf("Error! line %d: too many languages or no name\n", line_no);
+			return -1;
+		}
+		lang = &langs[num_langs++];
+		memset(lang, 0, sizeof(gen_lang_t));
+		lang->name = strdup(strtok(value, " \t"));
+		return 0;
+	}
+	if(lang == NULL)
+	{
+		printf("Error! line %d: %s before the first language\n", line_no, key);
+		return -1;
+	}
+
+	if(strcmp(key, "extensions") == 0)
+	{
+		for(word = strtok(value, " \t"); word; word = strtok(NULL, " \t"))
+		{
+			if(lang->num_extensions == GEN_MAX_EXTENSIONS - 1 || word[0] != '.')
+			{
+				printf("Error! line %d: bad extension %s\n", line_no, word);
+				return -1;
+			}
+			lang->extensions[lang->num_extensions++] = strdup(word);
+		}
+	}
+	else if(strcmp(key, "data") == 0)
+		return gen_add_words(lang, value, RES_KEYWORD_DATA);
+	else if(strcmp(key, "keywords") == 0)
+		return gen_add_words(lang, value, RES_KEYWORD_NON_DATA);
+	else if(strcmp(key, "operators") == 0 || strcmp(key, "symbols") == 0)
+	{
+		for(word = value; *word && *word != ' ' && *word != '\t'; word++)
+			lang->char_class[(unsigned char)*word] |= key[0] == 'o' ? CCLASS_OPERATOR : CCLASS_SYMBOL;
+	}
+	else if(strcmp(key, "directive") == 0 || strcmp(key, "line_comment") == 0)
+	{
+		if(value[0] == '\0' || (value[1] != '\0' && value[1] != ' ' && value[1] != '\t'))
+		{
+			printf("Error! line %d: %s needs a single character\n", line_no, key);
+			return -1;
+		}
+		if(key[0] == 'd')
+			lang->directive_char = (unsigned char)value[0];
+		else
+			lang->line_comment_char = (unsigned char)value[0];
+	}
+	else if(strcmp(key, "flags") == 0)
+	{
+		for(word = strtok(value, " \t"); word; word = strtok(NULL, " \t"))
+		{
+			for(idx = 0; idx < NUM_GEN_FLAGS && strcmp(gen_flags[idx].name, word); idx++)
+				;
+			if(idx == NUM_GEN_FLAGS)
+			{
+				printf("Error! line %d: unknown flag %s\n", line_no, word);
+				return -1;
+			}
+			lang->flags |= gen_flags[idx].flag;
+		}
+	}
+	else
+	{
+		printf("Error! line %d: unknown key %s\n", line_no, key);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* smallest table, and the first seed of it, where no two keywords share a slot */
+static int gen_perfect_hash(gen_lang_t *lang)
+{
+	unsigned char *used;
+	unsigned int size, seed;
+	int idx;
+
+	for(size = 8; size < 2u * lang->num_words; size *= 2)
+		;
+	for(; size <= 1u << 20; size *= 2)
+	{
+		if((used = malloc(size)) == NULL)
+			return -1;
+		for(seed = 1; seed <= GEN_MAX_SEEDS; seed++)
+		{
+			memset(used, 0, size);
+			for(idx = 0; idx < lang->num_words; idx++)
+			{
+				unsigned int slot = lang_hash(seed, lang->words[idx]) & (size - 1);
+
+				if(used[slot])
+					break;
+				used[slot] = 1;
+			}
+			if(idx == lang->num_words)
+			{
+				free(used);
+				lang->seed = seed;
+				lang->size = size;
+				return 0;
+			}
+		}
+		free(used);
+	}
+
+	return -1;
+}
+
+/* tables of every language as C */
+static void gen_write(FILE *fp, const char *def_file)
+{
+	gen_lang_t *lang;
+	unsigned int slot;
+	int idx, word, ch;
+
+	if(strrchr(def_file, '/'))
+		def_file = strrchr(def_file, '/') + 1;
+	fprintf(fp, "/* generated by tools/gen_lang from %s, do not edit */\n", def_file);
+	fprintf(fp, "#include <stdio.h>\n#include \"s2html_event.h\"\n#include \"s2html_lang.h\"\n\n");
+
+	for(idx = 0; idx < num_langs; idx++)
+	{
+		lang = &langs[idx];
+
+		fprintf(fp, "/* %s */\nstatic const char *const lang%d_extensions[] = {", lang->name, idx);
+		for(word = 0; word < lang->num_extensions; word++)
+			fprintf(fp, "\"%s\", ", lang->extensions[word]);
+		fprintf(fp, "NULL};\n\n");
+
+		fprintf(fp, "static const lang_kword_t lang%d_kwords[%u] = {\n", idx, lang->size);
+		for(word = 0; word < lang->num_words; word++)
+		{
+			slot = lang_hash(lang->seed, lang->words[word]) & (lang->size - 1);
+			fprintf(fp, "\t[%u] = {\"%s\", %s},\n", slot, lang->words[word],
+					lang->types[word] == RES_KEYWORD_DATA ? "RES_KEYWORD_DATA" : "RES_KEYWORD_NON_DATA");
+		}
+		fprintf(fp, "};\n\n");
+	}
+
+	fprintf(fp, "const lang_t lang_table[] = {\n");
+	for(idx = 0; idx < num_langs; idx++)
+	{
+		lang = &langs[idx];
+
+		fprintf(fp, "\t{\"%s\", lang%d_extensions, %d, %d, %d, %uu, %uu, lang%d_kwords,\n\t\t{",
+				lang->name, idx, lang->directive_char, lang->line_comment_char, lang->flags,
+				lang->seed, lang->size - 1, idx);
+		for(ch = 0; ch < 256; ch++)
+		{
+			if(lang->char_class[ch])
+				fprintf(fp, "[%d] = %d, ", ch, lang->char_class[ch]);
+		}
+		fprintf(fp, "}},\n");
+	}
+	fprintf(fp, "};\n\nconst int lang_count = %d;\n/**** End of file ****/\n", num_langs);
+}
+
+int main(int argc, char *argv[])
+{
+	char line[GEN_LINE_SIZE];
+	FILE *fp;
+	int line_no = 0, idx;
+
+	if(argc < 3)
+	{
+		printf("Usage: %s <languages.def> <output .c file>\n", argv[0]);
+		return 1;
+	}
+	if((fp = fopen(argv[1], "r")) == NULL)
+	{
+		printf("Error! File %s could not be opened\n", argv[1]);
+		return 2;
+	}
+	while(fgets(line, sizeof(line), fp))
+	{
+		if(gen_parse_line(line, ++line_no) < 0)
+		{
+			fclose(fp);
+			return 4;
+		}
+	}
+	fclose(fp);
+
+	if(num_langs == 0)
+	{
+		printf("Error! %s defines no language\n", argv[1]);
+		return 4;
+	}
+	for(idx = 0; idx < num_langs; idx++)
+	{
+		if(gen_perfect_hash(&langs[idx]) < 0)
+		{
+			printf("Error! no perfect hash found for the keywords of %s\n", langs[idx].name);
+			return 4;
+		}
+	}
+
+	if((fp = fopen(argv[2], "w")) == NULL)
+	{
+		printf("Error! could not create %s output file\n", argv[2]);
+		return 3;
+	}
+	gen_write(fp, argv[1]);
+	if(fclose(fp) != 0)
+	{
+		printf("Error! could not create %s output file\n", argv[2]);
+		return 3;
+	}
+
+	return 0;
+}
+/**** End of file ****/